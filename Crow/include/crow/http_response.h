@@ -256,7 +256,11 @@ namespace crow
                 }
                 if (complete_request_handler_)
                 {
-                    complete_request_handler_();
+                    // LOCAL PATCH (see Crow/PATCHES.md): the connection clears complete_request_handler_ while it runs. When end() is
+                    // called asynchronously the handler may hold the last reference to the connection,
+                    // so keep a local copy alive until the call returns.
+                    auto handler = complete_request_handler_;
+                    handler();
                     manual_length_header = false;
                     skip_body = false;
                 }
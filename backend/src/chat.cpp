@@ -1,11 +1,13 @@
 #include "chat.h"
+#include "json_escape.h"
 #include <algorithm>
 #include <sstream>
 
 std::atomic<int> Chat::next_id{1};
 
 Chat::Chat(const std::string& name, int creator_id, const std::string& type, bool public_chat)
-    : chat_name(name), chat_type(type), created_by(creator_id), is_public(public_chat) {
+    : chat_name(name), chat_type(type), member_count(0), created_by(creator_id), is_public(public_chat),
+      last_message_id(0), last_message_at(0), unread_count(0) {
     chat_id = next_id++;
     addMember(creator_id); // Создатель автоматически участник
     if (!public_chat) {
@@ -14,30 +16,27 @@ Chat::Chat(const std::string& name, int creator_id, const std::string& type, boo
 }
 
 void Chat::addToWhitelist(int user_id) {
-    if (!isInWhitelist(user_id)) {
-        whitelist_ids.push_back(user_id);
-    }
+    whitelist_ids.insert(user_id);
 }
 
 bool Chat::isInWhitelist(int user_id) const {
-    return std::find(whitelist_ids.begin(), whitelist_ids.end(), user_id) != whitelist_ids.end();
+    return whitelist_ids.contains(user_id);
 }
 
 void Chat::addMember(int user_id) {
-    if (!hasMember(user_id)) {
-        member_ids.push_back(user_id);
+    if (member_ids.insert(user_id)) {
+        member_count++;
     }
 }
 
 void Chat::removeMember(int user_id) {
-    member_ids.erase(
-        std::remove(member_ids.begin(), member_ids.end(), user_id),
-        member_ids.end()
-    );
+    if (member_ids.erase(user_id)) {
+        member_count--;
+    }
 }
 
 bool Chat::hasMember(int user_id) const {
-    return std::find(member_ids.begin(), member_ids.end(), user_id) != member_ids.end();
+    return member_ids.contains(user_id);
 }
 
 void Chat::addMessage(const Message& message) {
@@ -59,9 +58,9 @@ std::string Chat::toJson() const {
     std::stringstream ss;
     ss << "{"
        << "\"chat_id\":" << chat_id << ","
-       << "\"chat_name\":\"" << chat_name << "\","
+       << "\"chat_name\":\"" << escapeJson(chat_name) << "\","
        << "\"chat_type\":\"" << chat_type << "\","
-       << "\"member_count\":" << member_ids.size()
+       << "\"member_count\":" << member_count
        << "}";
     return ss.str();
 }
\ No newline at end of file
@@ -2,7 +2,9 @@
 #include <string>
 #include <vector>
 #include <atomic>
+#include <cstdint>
 #include "message.h"
+#include "member_set.h"
 
 class Chat {
 private:
@@ -12,11 +14,21 @@ public:
     int chat_id;
     std::string chat_name;
     std::string chat_type;
-    std::vector<int> member_ids;
-    std::vector<int> whitelist_ids;
+    // Только у чатов, собранных в памяти; из БД не загружаются - членство
+    // чата из БД проверяется через ChatManager::isUserInChat / isUserInWhitelist
+    MemberSet member_ids;
+    int member_count;              // у чатов из БД - колонка chats.member_count
+    MemberSet whitelist_ids;
     std::vector<Message> messages;
     int created_by;
     bool is_public;
+    
+    // Последнее сообщение (материализовано в таблице chats)
+    std::int64_t last_message_id;
+    std::int64_t last_message_at;  // unix-время, мс
+    std::string last_message_preview;
+    
+    int unread_count;              // для конкретного пользователя, заполняет ChatManager
 
     Chat(const std::string& name, int creator_id, const std::string& type = "group", bool public_chat = true);
     
@@ -1,44 +1,129 @@
 #include "chat_manager.h"
+#include "password_hasher.h"
 #include <algorithm>
+#include <climits>
+#include <stdexcept>
 #include <iostream>
+#include <sstream>
+#include <map>
 
-ChatManager::ChatManager(const std::string& db_path) : database(db_path) {
-    database.initialize();
+namespace {
+// Как часто рассылаются накопленные прочтения
+const std::chrono::milliseconds RECEIPT_INTERVAL(500);
+// Изменения присутствия схлопываются за этот интервал
+const std::chrono::milliseconds PRESENCE_INTERVAL(2000);
+// Срок жизни сессии, как в User::updateSession
+const std::chrono::hours SESSION_TTL(24 * 7);
+// last_seen сессий копится в памяти и пишется в БД не чаще этого интервала
+const std::chrono::seconds SESSION_FLUSH_INTERVAL(30);
+// По сколько пользователей и публичных чатов читается при построении индексов имён
+const int INDEX_LOAD_PAGE = 1000;
+// Сколько пользователей держит кэш аутентификации
+const std::size_t USER_CACHE_SIZE = 10000;
+// Проверяется при входе под несуществующим именем (итерации = DEFAULT_ITERATIONS)
+const char* const DUMMY_PASSWORD_HASH =
+    "pbkdf2-sha1$60000$6be7a1f7934ba3c967e694f899121621$bcf02b2922b261feb4a99813ff9007b0def9e7a8";
 }
 
-// User management
-int ChatManager::registerUser(const std::string& username, const std::string& password, const std::string& email) {
-    // Check if user already exists
-    User* existing_user = database.getUserByUsername(username);
-    if (existing_user) {
-        delete existing_user;
-        return -1; // User already exists
-    }
-    
-    // Create new user (in real project, hash the password!)
-    if (database.createUser(username, password, email)) {
-        User* new_user = database.getUserByUsername(username);
-        if (new_user) {
-            int user_id = new_user->user_id;
-            delete new_user;
-            return user_id;
+ChatManager::ChatManager(const std::string& db_path, bool signed_sessions)
+    : database(db_path), user_names(database), read_state(database), typing(events, timers), presence(timers),
+      stopping(false), signer(nullptr) {
+    // Недомигрированная схема ломается позже и по частям (например, поиск без FTS5):
+    // лучше не стартовать совсем, main выведет причину
+    if (!database.initialize()) {
+        throw std::runtime_error("failed to initialize database " + db_path);
+    }
+    
+    for (int chat_id : database.getChannelIds()) {
+        channel_ids.insert(chat_id);
+    }
+    // Пользователи и публичные чаты - страницами, без загрузки всей таблицы разом
+    std::vector<std::pair<int, std::string>> users = database.getUsernamesPage(0, INDEX_LOAD_PAGE);
+    while (!users.empty()) {
+        for (const auto& user : users) {
+            user_index.add(user.first, user.second);
+        }
+        users = database.getUsernamesPage(users.back().first, INDEX_LOAD_PAGE);
+    }
+    std::vector<Chat> page = database.getPublicChats(DIRECTORY_BY_MEMBERS, INT64_MAX, INT_MAX, INDEX_LOAD_PAGE);
+    while (!page.empty()) {
+        for (const Chat& chat : page) {
+            chat_index.add(chat.chat_id, chat.chat_name);
+        }
+        const Chat& last = page.back();
+        page = database.getPublicChats(DIRECTORY_BY_MEMBERS, last.member_count, last.chat_id, INDEX_LOAD_PAGE);
+    }
+    
+    if (signed_sessions) {
+        // Секрет хранится в БД, поэтому выданные токены переживают перезапуск
+        std::string secret;
+        if (!database.getSetting("session_secret", secret)) {
+            secret = SessionSigner::generateSecret();
+            database.setSetting("session_secret", secret);
+        }
+        signer = new SessionSigner(secret);
+        
+        for (const auto& revoked : database.getRevokedSessions(SessionSigner::now())) {
+            revokeSignature(revoked.first, revoked.second);
         }
     }
     
-    return -1;
+    publisher = std::thread([this]() { publisherLoop(); });
 }
 
-std::string ChatManager::loginUser(const std::string& username, const std::string& password) {
+ChatManager::~ChatManager() {
+    {
+        std::lock_guard<std::mutex> lock(publisher_mutex);
+        stopping = true;
+    }
+    publisher_cv.notify_all();
+    if (publisher.joinable()) publisher.join();
+    timers.shutdown();
+    flushSessionActivity();
+    
+    delete signer;
+}
+
+// User management
+int ChatManager::registerUser(const std::string& username, const std::string& password, const std::string& email) {
+    // Занятое имя отсекает сама вставка (UNIQUE), отдельная проверка не нужна
+    int user_id = database.createUser(username, PasswordHasher::hash(password), email);
+    if (user_id > 0) {
+        user_names.remember(user_id, username);
+        user_index.add(user_id, username);
+    }
+    return user_id;
+}
+
+std::string ChatManager::loginUser(const std::string& username, const std::string& password, const std::string& device) {
     User* user = database.getUserByUsername(username);
-    if (user && user->validatePassword(password)) {
-        std::string session_token = user->generateSessionToken();
+    if (!user) {
+        // Тот же PBKDF2, что и для существующего пользователя: время ответа не выдаёт, есть ли имя
+        bool needs_rehash = false;
+        PasswordHasher::verify(password, DUMMY_PASSWORD_HASH, needs_rehash);
+        return "";
+    }
+    
+    bool needs_rehash = false;
+    if (user->validatePassword(password, &needs_rehash)) {
+        if (needs_rehash) {
+            // Пароль открытым текстом или со старым числом итераций - перехешируем при входе
+            database.updatePasswordHash(user->user_id, PasswordHasher::hash(password));
+        }
         
-        // Update session in database
-        database.updateUserSession(user->user_id, session_token);
+        // Новая строка в sessions на каждый вход: сессии других устройств не затрагиваются
+        auto expires_at = SessionSigner::now() + std::chrono::duration_cast<std::chrono::seconds>(SESSION_TTL).count();
+        std::string session_token = signer ? signer->issue(user->user_id, expires_at) : user->generateSessionToken();
+        if (!database.createSession(SessionSigner::hashToken(session_token), user->user_id, device, expires_at)) {
+            delete user;
+            return "";
+        }
         
-        // Update local session map
-        std::unique_lock lock(sessions_mutex);
-        session_to_user[session_token] = user->user_id;
+        if (!signer) {
+            // Подписанный токен проверяется без БД и без записи в session_to_user
+            std::unique_lock lock(sessions_mutex);
+            trackSession(session_token, user->user_id, expires_at);
+        }
         
         std::cout << "User logged in: " << username << " (Session: " << session_token << ")" << std::endl;
         
@@ -46,56 +131,189 @@ std::string ChatManager::loginUser(const std::string& username, const std::strin
         return session_token;
     }
     
-    if (user) delete user;
+    delete user;
     return ""; // Invalid credentials
 }
 
 bool ChatManager::validateSession(const std::string& session_token) const {
-    std::shared_lock lock(sessions_mutex);
+    SessionSigner::Claims claims;
+    if (signer && signer->verify(session_token, claims)) {
+        std::shared_lock lock(sessions_mutex);
+        return revoked_signatures.count(claims.signature) == 0;
+    }
     
-    // Check local session map first
-    if (session_to_user.find(session_token) != session_to_user.end()) {
-        return true;
+    {
+        // Check local session map first
+        std::shared_lock lock(sessions_mutex);
+        if (session_to_user.find(session_token) != session_to_user.end()) {
+            return true;
+        }
     }
     
     // If not in local map, check database
-    User* user = database.getUserBySession(session_token);
-    if (user) {
-        // Check if session is still valid
-        bool valid = user->isSessionValid();
-        delete user;
-        return valid;
+    int user_id = 0;
+    std::int64_t expires_at = 0;
+    return database.getSession(SessionSigner::hashToken(session_token), user_id, expires_at);
+}
+
+int ChatManager::resolveSession(const std::string& session_token) {
+    // Подписанный токен: подпись, срок и список отозванных, без БД
+    SessionSigner::Claims claims;
+    if (signer && signer->verify(session_token, claims)) {
+        {
+            std::shared_lock lock(sessions_mutex);
+            if (revoked_signatures.count(claims.signature)) return -1;
+        }
+        noteSessionActivity(session_token);
+        return claims.user_id;
     }
     
-    return false;
+    {
+        // Check local session map first
+        std::shared_lock lock(sessions_mutex);
+        auto it = session_to_user.find(session_token);
+        if (it != session_to_user.end()) {
+            int user_id = it->second;
+            lock.unlock();
+            noteSessionActivity(session_token);
+            return user_id;
+        }
+    }
+    
+    // Fallback to database lookup (случайные токены): один поиск по первичному ключу
+    int user_id = -1;
+    std::int64_t expires_at = 0;
+    if (!database.getSession(SessionSigner::hashToken(session_token), user_id, expires_at)) {
+        return -1;
+    }
+    
+    {
+        // Add to local session map for faster access
+        std::unique_lock lock(sessions_mutex);
+        if (session_to_user.find(session_token) == session_to_user.end()) {
+            trackSession(session_token, user_id, expires_at);
+        }
+    }
+    noteSessionActivity(session_token);
+    return user_id;
 }
 
-User* ChatManager::getUserBySession(const std::string& session_token) {
-    std::shared_lock lock(sessions_mutex);
+void ChatManager::noteSessionActivity(const std::string& session_token) {
+    // Только память: last_seen пишется пачкой в flushSessionActivity
+    std::int64_t now = SessionSigner::now();
+    std::lock_guard<std::mutex> lock(activity_mutex);
+    session_activity[session_token] = now;
+}
+
+void ChatManager::flushSessionActivity() {
+    std::unordered_map<std::string, std::int64_t> activity;
+    {
+        std::lock_guard<std::mutex> lock(activity_mutex);
+        activity.swap(session_activity);
+    }
+    if (activity.empty()) return;
     
-    // Check local session map first
-    auto it = session_to_user.find(session_token);
-    if (it != session_to_user.end()) {
-        return getUserById(it->second);
+    std::vector<std::pair<std::string, std::int64_t>> last_seen;
+    last_seen.reserve(activity.size());
+    for (const auto& entry : activity) {
+        last_seen.emplace_back(SessionSigner::hashToken(entry.first), entry.second);
+    }
+    database.touchSessions(last_seen);
+}
+
+std::shared_ptr<const User> ChatManager::getCachedUser(int user_id) {
+    {
+        std::lock_guard<std::mutex> lock(users_mutex);
+        auto it = user_cache.find(user_id);
+        if (it != user_cache.end()) {
+            user_lru.splice(user_lru.begin(), user_lru, it->second.lru_position);
+            return it->second.user;
+        }
     }
     
-    // Fallback to database lookup
-    User* user = database.getUserBySession(session_token);
-    if (user && user->isSessionValid()) {
-        // Add to local session map for faster access
-        std::unique_lock unique_lock(sessions_mutex);
-        session_to_user[session_token] = user->user_id;
-        return user;
+    std::shared_ptr<const User> user(database.getUserById(user_id));
+    if (!user) return nullptr;
+    
+    std::lock_guard<std::mutex> lock(users_mutex);
+    auto it = user_cache.find(user_id);
+    if (it != user_cache.end()) {
+        return it->second.user; // другой поток успел раньше
     }
+    if (user_cache.size() >= USER_CACHE_SIZE) {
+        user_cache.erase(user_lru.back());
+        user_lru.pop_back();
+    }
+    user_lru.push_front(user_id);
+    user_cache.emplace(user_id, CachedUser{user, user_lru.begin()});
+    return user;
+}
+
+std::shared_ptr<const User> ChatManager::authenticate(const std::string& session_token) {
+    int user_id = resolveSession(session_token);
+    return user_id > 0 ? getCachedUser(user_id) : nullptr;
+}
+
+User* ChatManager::getUserBySession(const std::string& session_token) {
+    std::shared_ptr<const User> cached = authenticate(session_token);
+    if (!cached) return nullptr;
     
-    if (user) {
-        delete user;
+    User* user = new User(*cached);
+    user->status = getPresence(user->user_id);
+    return user;
+}
+
+bool ChatManager::logoutUser(const std::string& session_token) {
+    SessionSigner::Claims claims;
+    if (signer && signer->verify(session_token, claims)) {
+        database.addRevokedSession(claims.signature, claims.expires_at);
+        database.deleteSession(SessionSigner::hashToken(session_token));
+        std::unique_lock lock(sessions_mutex);
+        revokeSignature(claims.signature, claims.expires_at);
+        return true;
+    }
+    
+    int user_id = resolveSession(session_token);
+    if (user_id <= 0) return false;
+    
+    {
+        std::unique_lock lock(sessions_mutex);
+        session_to_user.erase(session_token);
     }
-    return nullptr;
+    database.deleteSession(SessionSigner::hashToken(session_token));
+    return true;
+}
+
+void ChatManager::revokeSignature(const std::string& signature, std::int64_t expires_at) {
+    revoked_signatures.insert(signature);
+    
+    // После истечения токен не пройдёт проверку срока, запись больше не нужна
+    std::int64_t remaining = expires_at - SessionSigner::now();
+    timers.schedule(std::chrono::seconds(remaining > 0 ? remaining : 1), [this, signature]() {
+        std::unique_lock lock(sessions_mutex);
+        revoked_signatures.erase(signature);
+    });
+}
+
+void ChatManager::trackSession(const std::string& session_token, int user_id, std::int64_t expires_at) {
+    session_to_user[session_token] = user_id;
+    // Истечение - таймер в колесе вместо периодического просмотра всех сессий
+    std::int64_t remaining = expires_at - SessionSigner::now();
+    timers.schedule(std::chrono::seconds(remaining > 0 ? remaining : 1),
+                    [this, session_token]() { expireSession(session_token); });
+}
+
+void ChatManager::expireSession(const std::string& session_token) {
+    std::unique_lock lock(sessions_mutex);
+    session_to_user.erase(session_token);
 }
 
 User* ChatManager::getUserById(int user_id) {
-    return database.getUserById(user_id);
+    std::shared_ptr<const User> cached = getCachedUser(user_id);
+    if (!cached) return nullptr;
+    
+    User* user = new User(*cached);
+    user->status = getPresence(user_id);
+    return user;
 }
 
 // Chat management
@@ -103,6 +321,14 @@ int ChatManager::createChat(const std::string& chat_name, int creator_id, const
     int chat_id = database.createChat(chat_name, creator_id, type, is_public);
     
     if (chat_id != -1) {
+        if (is_public && type != "direct") {
+            chat_index.add(chat_id, chat_name);
+        }
+        if (type == "channel") {
+            std::unique_lock<std::shared_mutex> lock(channels_mutex);
+            channel_ids.insert(chat_id);
+        }
+        events.joinChat(creator_id, chat_id);
         std::cout << "Created " << (is_public ? "public" : "private") 
                   << " chat: " << chat_name << " (ID: " << chat_id 
                   << ") by user " << creator_id << std::endl;
@@ -111,52 +337,44 @@ int ChatManager::createChat(const std::string& chat_name, int creator_id, const
     return chat_id;
 }
 
-bool ChatManager::addUserToChat(int user_id, int chat_id) {
-    std::cout << "DEBUG ChatManager::addUserToChat: user " << user_id 
-              << " to chat " << chat_id << std::endl;
-    
-    // Проверяем существование пользователя
-    User* user = getUserById(user_id);
-    if (!user) {
-        std::cout << "ERROR: User " << user_id << " not found!" << std::endl;
-        return false;
+int ChatManager::openDirectChat(int user_id, int peer_id, bool& created) {
+    int chat_id = database.getOrCreateDirectChat(user_id, peer_id, created);
+    if (created) {
+        events.joinChat(user_id, chat_id);
+        events.joinChat(peer_id, chat_id);
+        std::cout << "Created direct chat " << chat_id << " for users " << user_id
+                  << " and " << peer_id << std::endl;
     }
-    delete user;
-    
-    Chat* chat = getChatById(chat_id);
-    if (!chat) {
-        std::cout << "ERROR: Chat " << chat_id << " not found!" << std::endl;
-        return false;
-    }
-    
-    std::cout << "DEBUG: Chat found. Name: " << chat->chat_name 
-              << ", Public: " << chat->is_public 
-              << ", Members: " << chat->member_ids.size() << std::endl;
-    
-    // Проверяем доступ для приватных чатов
-    if (!chat->is_public && !chat->isInWhitelist(user_id)) {
-        std::cout << "ERROR: User " << user_id << " is not in whitelist for private chat " << chat_id << std::endl;
-        delete chat;
-        return false;
-    }
-    
-    // Проверяем, не состоит ли уже
-    if (chat->hasMember(user_id)) {
-        std::cout << "ERROR: User " << user_id << " already in chat " << chat_id << std::endl;
-        delete chat;
-        return false;
-    }
-    
-    bool success = database.addUserToChat(user_id, chat_id);
+    return chat_id;
+}
+
+bool ChatManager::addUserToChat(int user_id, int chat_id) {
+    return joinChat(user_id, chat_id) == JOIN_OK;
+}
+
+JoinResult ChatManager::joinChat(int user_id, int chat_id) {
+    // Все проверки доступа выполняет БД в той же транзакции, что и вставку
+    JoinResult result = database.addUserToChat(user_id, chat_id);
     
-    if (success) {
-        std::cout << "SUCCESS: Added user " << user_id << " to chat " << chat_id << std::endl;
-    } else {
-        std::cout << "ERROR: Database failed to add user " << user_id << " to chat " << chat_id << std::endl;
+    switch (result) {
+        case JOIN_OK:
+            events.joinChat(user_id, chat_id);
+            std::cout << "SUCCESS: Added user " << user_id << " to chat " << chat_id << std::endl;
+            break;
+        case JOIN_ALREADY_MEMBER:
+            std::cout << "ERROR: User " << user_id << " already in chat " << chat_id << std::endl;
+            break;
+        case JOIN_FORBIDDEN:
+            std::cout << "ERROR: User " << user_id << " is not in whitelist for private chat " << chat_id << std::endl;
+            break;
+        case JOIN_NOT_FOUND:
+            std::cout << "ERROR: User " << user_id << " or chat " << chat_id << " not found!" << std::endl;
+            break;
+        case JOIN_FAILED:
+            std::cout << "ERROR: Database failed to add user " << user_id << " to chat " << chat_id << std::endl;
+            break;
     }
-    
-    delete chat;
-    return success;
+    return result;
 }
 
 bool ChatManager::addToWhitelist(int chat_id, int user_id, int invited_by) {
@@ -168,7 +386,13 @@ bool ChatManager::isUserInWhitelist(int user_id, int chat_id) {
 }
 
 bool ChatManager::removeUserFromChat(int user_id, int chat_id) {
-    return database.removeUserFromChat(user_id, chat_id);
+    bool success = database.removeUserFromChat(user_id, chat_id);
+    if (success) {
+        read_state.forget(user_id, chat_id);
+        events.leaveChat(user_id, chat_id);
+        typing.stop(user_id, chat_id);
+    }
+    return success;
 }
 
 Chat* ChatManager::getChatById(int chat_id) {
@@ -176,41 +400,247 @@ Chat* ChatManager::getChatById(int chat_id) {
 }
 
 std::vector<Chat> ChatManager::getUserChats(int user_id) {
-    return database.getUserChats(user_id);
+    std::vector<Chat> chats = database.getUserChats(user_id);
+    
+    std::vector<int> chat_ids;
+    chat_ids.reserve(chats.size());
+    for (const auto& chat : chats) {
+        chat_ids.push_back(chat.chat_id);
+    }
+    
+    auto states = read_state.getStates(user_id, chat_ids);
+    for (auto& chat : chats) {
+        chat.unread_count = states[chat.chat_id].unread_count;
+    }
+    return chats;
 }
 
 std::vector<Chat> ChatManager::getAllChats() {
     return database.getAllChats();
 }
 
+std::vector<Chat> ChatManager::getPublicChats(DirectorySort sort, std::int64_t after_value, int after_chat_id, int limit) {
+    return database.getPublicChats(sort, after_value, after_chat_id, limit);
+}
+
+std::vector<int> ChatManager::getChatMembers(int chat_id) {
+    return database.getChatMemberIds(chat_id);
+}
+
+MemberSet ChatManager::getConnectedMembers(const MemberSet& members) const {
+    return events.connectedAmong(members);
+}
+
+bool ChatManager::isChannel(int chat_id) const {
+    std::shared_lock<std::shared_mutex> lock(channels_mutex);
+    return channel_ids.count(chat_id) > 0;
+}
+
+bool ChatManager::isChatAdmin(int user_id, int chat_id) {
+    return database.isChatAdmin(user_id, chat_id);
+}
+
+bool ChatManager::setChatAdmin(int chat_id, int user_id, int by_user_id) {
+    if (!database.isChatAdmin(by_user_id, chat_id)) {
+        return false;
+    }
+    return database.setMemberRole(user_id, chat_id, "admin");
+}
+
+std::vector<int> ChatManager::getChatMembersPage(int chat_id, int after_user_id, int limit) {
+    return database.getChatMemberIdsPage(chat_id, after_user_id, limit);
+}
+
+bool ChatManager::isUserInChat(int user_id, int chat_id) {
+    return database.isUserInChat(user_id, chat_id);
+}
+
 // Message management
 bool ChatManager::sendMessage(int chat_id, int sender_id, const std::string& content, const std::string& type) {
-    // Check if user has access to chat
-    if (!database.isUserInChat(sender_id, chat_id)) {
-        std::cout << "User " << sender_id << " doesn't have access to chat " << chat_id << std::endl;
+    // Участник чата; в канале - только admin (одна проверка по ключу)
+    if (!database.canPost(sender_id, chat_id)) {
+        std::cout << "User " << sender_id << " can't post to chat " << chat_id << std::endl;
         return false;
     }
     
-    bool success = database.addMessage(chat_id, sender_id, content, type);
-    
-    if (success) {
-        User* user = getUserById(sender_id);
-        if (user) {
-            std::cout << "Message from " << user->username << " in chat " << chat_id << ": " << content << std::endl;
-            delete user;
-        }
+    Message* message = database.addMessage(chat_id, sender_id, content, type);
+    if (!message) {
+        return false;
     }
+    message->sender_name = user_names.get(sender_id);
     
-    return success;
+    message_cache.append(*message);
+    read_state.onMessage(chat_id, sender_id, message->message_id);
+    typing.stop(sender_id, chat_id);
+    if (isChannel(chat_id)) {
+        // Подписчики канала не опрашивают сервер: сообщение сериализуется один раз
+        // и та же строка уходит всем подключённым
+        events.sendToChat(chat_id, "{\"type\":\"message\",\"chat_id\":" + std::to_string(chat_id) +
+                                   ",\"message\":" + message->toJson() + "}", sender_id);
+    }
+    std::cout << "Message from " << message->sender_name << " in chat " << chat_id << ": " << content << std::endl;
+    delete message;
+    return true;
 }
 
 std::vector<Message> ChatManager::getChatMessages(int chat_id, int user_id, int count) {
     // Check if user has access to chat
-    if (!database.isUserInChat(user_id, chat_id)) {
+    if (count <= 0 || !database.isUserInChat(user_id, chat_id)) {
         return {};
     }
     
-    return database.getChatMessages(chat_id, count);
+    std::vector<Message> messages;
+    if (message_cache.get(chat_id, count, messages)) {
+        return messages;
+    }
+    
+    // Версию снимаем до запроса: если за это время придёт сообщение, put ничего не запишет
+    std::uint64_t version = message_cache.version(chat_id);
+    int fetch = std::max(count, static_cast<int>(message_cache.getCapacity()));
+    messages = database.getChatMessages(chat_id, fetch);
+    user_names.fill(messages); // в кэш страница попадает уже с именами
+    message_cache.put(chat_id, messages, fetch, version);
+    
+    if (static_cast<int>(messages.size()) > count) {
+        messages.erase(messages.begin(), messages.end() - count);
+    }
+    return messages;
+}
+
+std::vector<Message> ChatManager::searchMessages(int user_id, const std::string& text, int chat_id, int limit, int offset) {
+    std::vector<Message> results = database.searchMessages(user_id, text, chat_id, limit, offset);
+    user_names.fill(results);
+    return results;
+}
+
+bool ChatManager::markChatRead(int user_id, int chat_id, std::int64_t message_id, ReadStateTracker::State& state) {
+    // Членство - по ключу chat_members; сама отметка меняется в памяти
+    if (!database.isUserInChat(user_id, chat_id)) {
+        return false;
+    }
+    
+    return read_state.markRead(user_id, chat_id, message_id, state);
+}
+
+int ChatManager::getUnreadCount(int user_id, int chat_id) {
+    if (!database.isUserInChat(user_id, chat_id)) {
+        return 0;
+    }
+    return read_state.getState(user_id, chat_id).unread_count;
+}
+
+void ChatManager::publishReadReceipts() {
+    auto receipts = read_state.takeReceipts();
+    if (receipts.empty() || !events.hasSubscribers()) return;
+    
+    std::map<int, std::vector<ReadMarker>> by_chat;
+    for (const auto& receipt : receipts) {
+        by_chat[receipt.chat_id].push_back(receipt);
+    }
+    
+    // Одно событие на чат со всеми прочтениями за интервал
+    for (const auto& chat : by_chat) {
+        if (isChannel(chat.first)) continue;
+        std::stringstream ss;
+        ss << "{\"type\":\"read_receipts\",\"chat_id\":" << chat.first << ",\"receipts\":[";
+        for (std::size_t i = 0; i < chat.second.size(); i++) {
+            if (i > 0) ss << ",";
+            ss << "{\"user_id\":" << chat.second[i].user_id
+               << ",\"message_id\":" << chat.second[i].last_read_message_id << "}";
+        }
+        ss << "]}";
+        
+        events.sendToChat(chat.first, ss.str());
+    }
+}
+
+int ChatManager::subscribeEvents(int user_id, EventHub::Sink sink) {
+    presence.connect(user_id);
+    // Сначала подписка, потом чтение чатов: вход в чат между ними не потеряется
+    int subscription_id = events.subscribe(user_id, std::move(sink));
+    events.loadChats(subscription_id, database.getUserChatIds(user_id));
+    return subscription_id;
+}
+
+void ChatManager::unsubscribeEvents(int user_id, int subscription_id) {
+    events.unsubscribe(subscription_id);
+    presence.disconnect(user_id);
+}
+
+void ChatManager::touchPresence(int user_id) {
+    presence.touch(user_id);
+}
+
+std::string ChatManager::getPresence(int user_id) const {
+    return PresenceTable::statusName(presence.getStatus(user_id));
+}
+
+void ChatManager::publishPresence() {
+    auto deltas = presence.collectDeltas();
+    if (deltas.empty() || !events.hasSubscribers()) return;
+    
+    // Изменения группируются по чатам: участник большого чата получает одно событие
+    // за интервал со всеми изменениями, а не по событию на каждого пользователя
+    std::map<int, std::vector<PresenceTable::Delta>> by_chat;
+    for (const auto& delta : deltas) {
+        std::vector<int> chat_ids = events.getUserChats(delta.user_id);
+        if (chat_ids.empty() && delta.status == PresenceTable::OFFLINE) {
+            // Отключившийся пользователь уже убран из EventHub
+            chat_ids = database.getUserChatIds(delta.user_id);
+        }
+        for (int chat_id : chat_ids) {
+            by_chat[chat_id].push_back(delta);
+        }
+    }
+    
+    for (const auto& chat : by_chat) {
+        if (isChannel(chat.first)) continue;
+        std::stringstream ss;
+        ss << "{\"type\":\"presence\",\"chat_id\":" << chat.first << ",\"users\":[";
+        for (std::size_t i = 0; i < chat.second.size(); i++) {
+            if (i > 0) ss << ",";
+            ss << "{\"user_id\":" << chat.second[i].user_id
+               << ",\"status\":\"" << PresenceTable::statusName(chat.second[i].status) << "\"}";
+        }
+        ss << "]}";
+        
+        events.sendToChat(chat.first, ss.str());
+    }
+}
+
+bool ChatManager::setTyping(int user_id, const std::string& username, int chat_id, bool is_typing) {
+    // Членство берём из EventHub: индикатор не должен трогать БД
+    if (!events.isInChat(user_id, chat_id) || isChannel(chat_id)) {
+        return false;
+    }
+    
+    if (!is_typing) {
+        typing.stop(user_id, chat_id);
+        return true;
+    }
+    return typing.start(user_id, username, chat_id);
+}
+
+void ChatManager::publisherLoop() {
+    auto next_presence = std::chrono::steady_clock::now() + PRESENCE_INTERVAL;
+    auto next_session_flush = std::chrono::steady_clock::now() + SESSION_FLUSH_INTERVAL;
+    std::unique_lock<std::mutex> lock(publisher_mutex);
+    while (!stopping) {
+        publisher_cv.wait_for(lock, RECEIPT_INTERVAL, [this]() { return stopping; });
+        if (stopping) break;
+        lock.unlock();
+        publishReadReceipts();
+        if (std::chrono::steady_clock::now() >= next_presence) {
+            publishPresence();
+            next_presence = std::chrono::steady_clock::now() + PRESENCE_INTERVAL;
+        }
+        if (std::chrono::steady_clock::now() >= next_session_flush) {
+            flushSessionActivity();
+            cleanupExpiredSessions();
+            next_session_flush = std::chrono::steady_clock::now() + SESSION_FLUSH_INTERVAL;
+        }
+        lock.lock();
+    }
 }
 
 // Search functionality
@@ -218,13 +648,23 @@ Chat* ChatManager::searchChatById(int chat_id) {
     return database.getChatById(chat_id);
 }
 
+std::vector<NameIndex::Match> ChatManager::searchUsers(const std::string& prefix, int after_id, std::size_t limit) const {
+    return user_index.find(prefix, after_id, limit);
+}
+
+std::vector<NameIndex::Match> ChatManager::searchChats(const std::string& prefix, int after_id, std::size_t limit) const {
+    return chat_index.find(prefix, after_id, limit);
+}
+
 // Utility
 std::vector<User> ChatManager::getAllUsers() {
-    // This would need to be implemented in Database class
-    // For now, return empty vector
-    return {};
+    return database.getAllUsers();
 }
 
 void ChatManager::cleanupExpiredSessions() {
-    // In real project, clean up expired sessions from database
+    // Из памяти сессии убирает колесо таймеров, здесь - одним запросом из БД
+    int deleted = database.deleteExpiredSessions();
+    if (deleted > 0) {
+        std::cout << "Expired sessions cleared: " << deleted << std::endl;
+    }
 }
\ No newline at end of file
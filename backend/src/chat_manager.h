@@ -1,38 +1,115 @@
 #pragma once
 #include <vector>
+#include <list>
+#include <memory>
 #include <unordered_map>
 #include <mutex>
 #include <shared_mutex>
+#include <thread>
+#include <condition_variable>
 #include "user.h"
 #include "chat.h"
 #include "message.h"
 #include "database.h"
+#include "message_cache.h"
+#include "read_state.h"
+#include "event_hub.h"
+#include "timer_wheel.h"
+#include "typing.h"
+#include "presence.h"
+#include "session_signer.h"
+#include "user_names.h"
+#include "name_index.h"
+#include <unordered_set>
 
 class ChatManager {
 private:
     mutable Database database;
-    std::unordered_map<std::string, int> session_to_user; // session_token -> user_id
+    UserNames user_names; // sender_name сообщений: в таблице messages имени нет
+    MessageCache message_cache; // хвосты переписки, см. getChatMessages
+    ReadStateTracker read_state; // непрочитанные; объявлен после database - сбрасывается в неё при разрушении
+    EventHub events;
+    TimerWheel timers;   // общее колесо таймаутов; останавливается в деструкторе до разрушения typing/presence
+    TypingTracker typing;
+    PresenceTable presence;
+    
+    // Фоновый поток: прочтения и присутствие (не чаще одного события на чат за интервал),
+    // чистка истёкших сессий
+    std::thread publisher;
+    std::mutex publisher_mutex;
+    std::condition_variable publisher_cv;
+    bool stopping;
+    void publisherLoop();
+    std::unordered_map<std::string, int> session_to_user; // session_token -> user_id (случайные токены)
+    std::unordered_set<std::string> revoked_signatures; // отозванные подписанные токены до их истечения
+    SessionSigner* signer; // nullptr - выдаются старые случайные токены
     
     mutable std::shared_mutex sessions_mutex;
     
+    // Пользователи, прошедшие аутентификацию (LRU, не больше USER_CACHE_SIZE).
+    // Вытесненную запись держит shared_ptr, пока её использует запрос
+    struct CachedUser {
+        std::shared_ptr<const User> user;
+        std::list<int>::iterator lru_position;
+    };
+    std::unordered_map<int, CachedUser> user_cache;
+    std::list<int> user_lru; // спереди - недавно использованные
+    std::mutex users_mutex;
+    
+    // Подсказки по началу имени: все пользователи и публичные чаты (не личные)
+    NameIndex user_index;
+    NameIndex chat_index;
+    
+    // Каналы: им не рассылаются присутствие, прочтения и набор текста (аудитория - сотни тысяч)
+    std::unordered_set<int> channel_ids;
+    mutable std::shared_mutex channels_mutex;
+    
+    // last_seen по токенам с прошлой записи в БД
+    std::unordered_map<std::string, std::int64_t> session_activity;
+    std::mutex activity_mutex;
+    
+    void trackSession(const std::string& session_token, int user_id, std::int64_t expires_at); // под unique-блокировкой sessions_mutex
+    void expireSession(const std::string& session_token);
+    void revokeSignature(const std::string& signature, std::int64_t expires_at); // под unique-блокировкой sessions_mutex
+    int resolveSession(const std::string& session_token); // user_id или -1
+    void noteSessionActivity(const std::string& session_token);
+    void flushSessionActivity();
+    std::shared_ptr<const User> getCachedUser(int user_id);
+    
     User* getUserById(int user_id);
 
 public:
-    ChatManager(const std::string& db_path = "chat.db");
+    ChatManager(const std::string& db_path = "chat.db", bool signed_sessions = true);
+    ~ChatManager();
     
     // User management
+    // Обе считают PBKDF2 (десятки мс): веб-сервер вызывает их только с пула auth_executor
     int registerUser(const std::string& username, const std::string& password, const std::string& email = "");
-    std::string loginUser(const std::string& username, const std::string& password);
+    std::string loginUser(const std::string& username, const std::string& password, const std::string& device = "");
     bool validateSession(const std::string& session_token) const;
-    User* getUserBySession(const std::string& session_token);
+    User* getUserBySession(const std::string& session_token); // копия, удаляет вызывающий
+    std::shared_ptr<const User> authenticate(const std::string& session_token);
+    bool logoutUser(const std::string& session_token);
     
     // Chat management
     int createChat(const std::string& chat_name, int creator_id, const std::string& type = "group", bool is_public = true); // ← ИЗМЕНЕНО
     bool addUserToChat(int user_id, int chat_id);
+    JoinResult joinChat(int user_id, int chat_id); // с причиной отказа
+    int openDirectChat(int user_id, int peer_id, bool& created); // личный чат пары, -1 - нет собеседника
     bool removeUserFromChat(int user_id, int chat_id);
     Chat* getChatById(int chat_id);
     std::vector<Chat> getUserChats(int user_id);
     std::vector<Chat> getAllChats();
+    std::vector<Chat> getPublicChats(DirectorySort sort, std::int64_t after_value, int after_chat_id, int limit);
+    std::vector<int> getChatMembers(int chat_id);
+    MemberSet getConnectedMembers(const MemberSet& members) const; // с открытым соединением
+    bool isUserInChat(int user_id, int chat_id);
+    
+    // Каналы (chat_type "channel"): пишут только admin, участники - подписчики
+    bool isChannel(int chat_id) const;
+    bool isChatAdmin(int user_id, int chat_id);
+    bool setChatAdmin(int chat_id, int user_id, int by_user_id); // by_user_id должен быть admin
+    std::vector<int> getChatMembersPage(int chat_id, int after_user_id, int limit);
     
     // Whitelist management (для приватных чатов) ← ДОБАВЛЕНО
     bool addToWhitelist(int chat_id, int user_id, int invited_by);
@@ -41,11 +118,33 @@ public:
     // Message management
     bool sendMessage(int chat_id, int sender_id, const std::string& content, const std::string& type = "text");
     std::vector<Message> getChatMessages(int chat_id, int user_id, int count = 50);
+    // Поиск по тексту в чатах пользователя; content - фрагмент с совпадениями
+    std::vector<Message> searchMessages(int user_id, const std::string& text, int chat_id, int limit, int offset);
+    
+    // Read state: message_id <= 0 - прочитать всё
+    bool markChatRead(int user_id, int chat_id, std::int64_t message_id, ReadStateTracker::State& state);
+    int getUnreadCount(int user_id, int chat_id);
+    
+    // Push events
+    EventHub& getEventHub() { return events; }
+    int subscribeEvents(int user_id, EventHub::Sink sink); // id подписки в EventHub
+    void unsubscribeEvents(int user_id, int subscription_id);
+    void publishReadReceipts();
+    
+    // Presence: online/idle/offline по подключениям и активности
+    void touchPresence(int user_id);
+    std::string getPresence(int user_id) const;
+    void publishPresence();
+    
+    // Typing indicators (только память, рассылаются подключённым участникам чата)
+    bool setTyping(int user_id, const std::string& username, int chat_id, bool is_typing);
     
     // Search functionality
     Chat* searchChatById(int chat_id);
+    std::vector<NameIndex::Match> searchUsers(const std::string& prefix, int after_id, std::size_t limit) const;
+    std::vector<NameIndex::Match> searchChats(const std::string& prefix, int after_id, std::size_t limit) const;
     
     // Utility
     std::vector<User> getAllUsers();
-    void cleanupExpiredSessions();
+    void cleanupExpiredSessions(); // удаляет истёкшие строки sessions
 };
\ No newline at end of file
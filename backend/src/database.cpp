@@ -1,9 +1,233 @@
 #include "database.h"
+#include "session_signer.h"
 #include <iostream>
 #include <sstream>
 #include <chrono>
+#include <algorithm>
 
-Database::Database(const std::string& path) : db_path(path), db(nullptr) {}
+namespace {
+// Длина превью последнего сообщения в списке чатов (в символах)
+const std::size_t PREVIEW_LENGTH = 100;
+// Сколько id в одном запросе getUsernames (SQLite ограничивает число параметров)
+const std::size_t NAME_BATCH = 500;
+
+// Обрезает по границе символа UTF-8, а не байта
+std::string makePreview(const std::string& content) {
+    std::size_t chars = 0;
+    for (std::size_t i = 0; i < content.size(); i++) {
+        if ((static_cast<unsigned char>(content[i]) & 0xC0) != 0x80) {
+            if (chars == PREVIEW_LENGTH) return content.substr(0, i);
+            chars++;
+        }
+    }
+    return content;
+}
+
+// Минимальная длина (в символах) последнего слова для поиска по префиксу: совпадает
+// с prefix-индексом messages_fts, короткий префикс совпал бы с большей частью сообщений
+const std::size_t FTS_MIN_PREFIX = 3;
+
+// Запрос пользователя -> выражение MATCH: каждое слово в кавычках (синтаксис FTS5 не
+// интерпретируется), слова объединяются по AND, последнее (от FTS_MIN_PREFIX символов) - как префикс
+std::string ftsQuery(const std::string& text) {
+    std::vector<std::string> terms;
+    std::istringstream words(text);
+    std::string word, last;
+    while (words >> word) {
+        last = word;
+        std::string quoted = "\"";
+        for (char c : word) {
+            if (c == '"') quoted += '"';
+            quoted += c;
+        }
+        terms.push_back(quoted + "\"");
+    }
+    
+    std::string query;
+    for (std::size_t i = 0; i < terms.size(); i++) {
+        if (i > 0) query += " ";
+        query += terms[i];
+    }
+    
+    std::size_t last_chars = 0;
+    for (char c : last) {
+        if ((static_cast<unsigned char>(c) & 0xC0) != 0x80) last_chars++;
+    }
+    if (last_chars >= FTS_MIN_PREFIX) query += "*";
+    return query;
+}
+
+// Миграции схемы: номер применённой хранится в PRAGMA user_version.
+// Новые миграции только добавляются в конец.
+const char* const MIGRATIONS[] = {
+    // 1: материализованные member_count и последнее сообщение в chats
+    "ALTER TABLE chats ADD COLUMN member_count INTEGER NOT NULL DEFAULT 0;"
+    "ALTER TABLE chats ADD COLUMN last_message_id INTEGER;"
+    "ALTER TABLE chats ADD COLUMN last_message_at DATETIME;"
+    "ALTER TABLE chats ADD COLUMN last_message_preview TEXT;"
+    "UPDATE chats SET member_count = "
+    "(SELECT COUNT(*) FROM chat_members m WHERE m.chat_id = chats.chat_id);"
+    "UPDATE chats SET last_message_id = "
+    "(SELECT MAX(message_id) FROM messages WHERE messages.chat_id = chats.chat_id);"
+    "UPDATE chats SET "
+    "last_message_at = (SELECT timestamp FROM messages WHERE message_id = chats.last_message_id),"
+    "last_message_preview = (SELECT substr(content, 1, 100) FROM messages WHERE message_id = chats.last_message_id);"
+    "CREATE INDEX IF NOT EXISTS idx_chats_last_message ON chats(last_message_at, chat_id);",
+    
+    // 2: отметки прочтения; существующая история считается прочитанной
+    "CREATE TABLE IF NOT EXISTS read_markers ("
+    "user_id INTEGER NOT NULL,"
+    "chat_id INTEGER NOT NULL,"
+    "last_read_message_id INTEGER NOT NULL DEFAULT 0,"
+    "PRIMARY KEY (user_id, chat_id)"
+    ") WITHOUT ROWID;"
+    "INSERT OR IGNORE INTO read_markers (user_id, chat_id, last_read_message_id) "
+    "SELECT m.user_id, m.chat_id, COALESCE(c.last_message_id, 0) "
+    "FROM chat_members m JOIN chats c ON c.chat_id = m.chat_id;"
+    "CREATE INDEX IF NOT EXISTS idx_messages_chat ON messages(chat_id, message_id);",
+    
+    // 3: настройки сервера (секрет подписи токенов) и отозванные подписанные токены
+    "CREATE TABLE IF NOT EXISTS settings ("
+    "key TEXT PRIMARY KEY,"
+    "value TEXT NOT NULL"
+    ") WITHOUT ROWID;"
+    "CREATE TABLE IF NOT EXISTS revoked_sessions ("
+    "signature TEXT PRIMARY KEY,"
+    "expires_at INTEGER NOT NULL"
+    ") WITHOUT ROWID;",
+    
+    // 4: сессии по устройствам вместо users.session_token (перенос токенов - importLegacySessions)
+    "CREATE TABLE IF NOT EXISTS sessions ("
+    "token_hash TEXT PRIMARY KEY,"
+    "user_id INTEGER NOT NULL,"
+    "device TEXT,"
+    "created_at INTEGER NOT NULL,"
+    "expires_at INTEGER NOT NULL,"
+    "last_seen INTEGER NOT NULL,"
+    "FOREIGN KEY (user_id) REFERENCES users(user_id)"
+    ") WITHOUT ROWID;"
+    "CREATE INDEX IF NOT EXISTS idx_sessions_user ON sessions(user_id);"
+    "CREATE INDEX IF NOT EXISTS idx_sessions_expires ON sessions(expires_at);",
+    
+    // 5: время сообщений - целое число мс с эпохи (UTC) вместо текста DATETIME
+    "UPDATE messages SET timestamp = COALESCE(CAST(strftime('%s', timestamp) AS INTEGER), 0) * 1000 "
+    "WHERE typeof(timestamp) = 'text';"
+    "UPDATE chats SET last_message_at = COALESCE(CAST(strftime('%s', last_message_at) AS INTEGER), 0) * 1000 "
+    "WHERE typeof(last_message_at) = 'text';",
+    
+    // 6: имя отправителя не хранится в каждом сообщении (берётся из users при чтении).
+    // Таблица пересоздаётся: заодно у старых баз уходят AUTOINCREMENT и тип DATETIME
+    "CREATE TABLE messages_new ("
+    "message_id INTEGER PRIMARY KEY,"
+    "chat_id INTEGER NOT NULL,"
+    "sender_id INTEGER NOT NULL,"
+    "content TEXT NOT NULL,"
+    "message_type TEXT DEFAULT 'text',"
+    "timestamp INTEGER NOT NULL,"
+    "FOREIGN KEY (chat_id) REFERENCES chats(chat_id),"
+    "FOREIGN KEY (sender_id) REFERENCES users(user_id)"
+    ");"
+    "INSERT INTO messages_new (message_id, chat_id, sender_id, content, message_type, timestamp) "
+    "SELECT message_id, chat_id, sender_id, content, message_type, timestamp FROM messages;"
+    "DROP TABLE messages;"
+    "ALTER TABLE messages_new RENAME TO messages;"
+    "CREATE INDEX IF NOT EXISTS idx_messages_chat ON messages(chat_id, message_id);",
+    
+    // 7: роли участников (в каналах пишут только admin), создатель - admin;
+    // индекс (chat_id, user_id) - постраничный список участников без сортировки
+    "ALTER TABLE chat_members ADD COLUMN role TEXT NOT NULL DEFAULT 'member';"
+    "UPDATE chat_members SET role = 'admin' "
+    "WHERE user_id = (SELECT created_by FROM chats WHERE chats.chat_id = chat_members.chat_id);"
+    "CREATE INDEX IF NOT EXISTS idx_chat_members_chat_user ON chat_members(chat_id, user_id);",
+    
+    // 8: личные чаты - не больше одного на пару, пара упорядочена (user_a < user_b)
+    "CREATE TABLE IF NOT EXISTS direct_chats ("
+    "user_a INTEGER NOT NULL,"
+    "user_b INTEGER NOT NULL,"
+    "chat_id INTEGER NOT NULL UNIQUE,"
+    "PRIMARY KEY (user_a, user_b),"
+    "CHECK (user_a < user_b),"
+    "FOREIGN KEY (chat_id) REFERENCES chats(chat_id)"
+    ") WITHOUT ROWID;",
+    
+    // 9: полнотекстовый поиск - FTS5 с внешним содержимым (текст хранится только в messages),
+    // индекс поддерживают триггеры; существующие сообщения индексируются через 'rebuild'
+    "CREATE VIRTUAL TABLE IF NOT EXISTS messages_fts USING fts5("
+    "content, content='messages', content_rowid='message_id', "
+    "tokenize='unicode61 remove_diacritics 2', prefix='3');"
+    "CREATE TRIGGER IF NOT EXISTS messages_fts_insert AFTER INSERT ON messages BEGIN "
+    "INSERT INTO messages_fts (rowid, content) VALUES (new.message_id, new.content); END;"
+    "CREATE TRIGGER IF NOT EXISTS messages_fts_delete AFTER DELETE ON messages BEGIN "
+    "INSERT INTO messages_fts (messages_fts, rowid, content) VALUES ('delete', old.message_id, old.content); END;"
+    "CREATE TRIGGER IF NOT EXISTS messages_fts_update AFTER UPDATE OF content ON messages BEGIN "
+    "INSERT INTO messages_fts (messages_fts, rowid, content) VALUES ('delete', old.message_id, old.content);"
+    "INSERT INTO messages_fts (rowid, content) VALUES (new.message_id, new.content); END;"
+    "INSERT INTO messages_fts (messages_fts) VALUES ('rebuild');",
+    
+    // 10: каталог публичных чатов - частичные индексы под обе сортировки и keyset-пагинацию
+    "CREATE INDEX IF NOT EXISTS idx_chats_public_members ON chats(member_count, chat_id) WHERE is_public = 1;"
+    "CREATE INDEX IF NOT EXISTS idx_chats_public_activity ON chats(COALESCE(last_message_at, 0), chat_id) WHERE is_public = 1;",
+};
+
+// Миграция, после которой старые токены переносятся из users в sessions
+const int SESSIONS_MIGRATION = 4;
+// Создаёт messages_fts: без FTS5 в сборке SQLite не применится
+const int MESSAGE_SEARCH_MIGRATION = 9;
+// Срок для перенесённых токенов: в users он не хранился
+const std::int64_t LEGACY_SESSION_TTL = 7 * 24 * 3600;
+
+// Колонки чата в порядке, который ожидает readChat (таблица chats под псевдонимом c)
+#define CHAT_COLUMNS \
+    "c.chat_id, c.chat_name, c.chat_type, c.created_by, c.is_public, " \
+    "c.member_count, c.last_message_id, c.last_message_at, c.last_message_preview "
+
+std::int64_t unixNow() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string columnText(sqlite3_stmt* stmt, int column, const std::string& fallback = "") {
+    const unsigned char* ptr = sqlite3_column_text(stmt, column);
+    return ptr ? reinterpret_cast<const char*>(ptr) : fallback;
+}
+
+Chat readChat(sqlite3_stmt* stmt) {
+    bool is_public = sqlite3_column_int(stmt, 4) == 1;
+    Chat chat(columnText(stmt, 1), sqlite3_column_int(stmt, 3), columnText(stmt, 2, "group"), is_public);
+    chat.chat_id = sqlite3_column_int(stmt, 0);
+    // Конструктор добавил создателя; участники грузятся отдельно, только когда нужны
+    chat.member_ids.clear();
+    chat.whitelist_ids.clear();
+    chat.member_count = sqlite3_column_int(stmt, 5);
+    chat.last_message_id = sqlite3_column_int64(stmt, 6);
+    chat.last_message_at = sqlite3_column_int64(stmt, 7);
+    chat.last_message_preview = columnText(stmt, 8);
+    return chat;
+}
+}
+
+Transaction::Transaction(sqlite3* database) : db(database), active(false) {
+    active = sqlite3_exec(db, "SAVEPOINT tx", nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+Transaction::~Transaction() {
+    if (active) {
+        sqlite3_exec(db, "ROLLBACK TO tx; RELEASE tx", nullptr, nullptr, nullptr);
+    }
+}
+
+bool Transaction::commit() {
+    if (!active) return false;
+    active = false;
+    if (sqlite3_exec(db, "RELEASE tx", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        sqlite3_exec(db, "ROLLBACK TO tx; RELEASE tx", nullptr, nullptr, nullptr);
+        return false;
+    }
+    return true;
+}
+
+Database::Database(const std::string& path)
+    : db(nullptr), db_path(path), message_ids(SnowflakeGenerator::nodeFromEnvironment()) {}
 
 Database::~Database() {
     close();
@@ -23,7 +247,6 @@ bool Database::initialize() {
     "username TEXT UNIQUE NOT NULL,"
     "password_hash TEXT NOT NULL,"
     "email TEXT,"
-    "session_token TEXT,"
     "created_at DATETIME DEFAULT CURRENT_TIMESTAMP"
     ");"
     
@@ -57,14 +280,16 @@ bool Database::initialize() {
     "FOREIGN KEY (chat_id) REFERENCES chats(chat_id)"
     ");"
     
+    // PRIMARY KEY (user_id, chat_id) не помогает искать по chat_id
+    "CREATE INDEX IF NOT EXISTS idx_chat_members_chat ON chat_members(chat_id);"
+    
     "CREATE TABLE IF NOT EXISTS messages ("
-    "message_id INTEGER PRIMARY KEY AUTOINCREMENT,"
+    "message_id INTEGER PRIMARY KEY," // SnowflakeGenerator
     "chat_id INTEGER NOT NULL,"
     "sender_id INTEGER NOT NULL,"
-    "sender_name TEXT NOT NULL,"
     "content TEXT NOT NULL,"
     "message_type TEXT DEFAULT 'text',"
-    "timestamp DATETIME DEFAULT CURRENT_TIMESTAMP,"
+    "timestamp INTEGER NOT NULL," // unix-время, мс
     "FOREIGN KEY (chat_id) REFERENCES chats(chat_id),"
     "FOREIGN KEY (sender_id) REFERENCES users(user_id)"
     ");";
@@ -77,10 +302,84 @@ bool Database::initialize() {
         return false;
     }
     
+    if (!migrate()) {
+        return false;
+    }
+    
+    if (!seedMessageIds()) {
+        return false;
+    }
+    
     std::cout << "Database initialized successfully" << std::endl;
     return true;
 }
 
+bool Database::seedMessageIds() {
+    // Часы могли уйти назад, пока сервер был остановлен: без этого новые id
+    // попадут ниже сохранённых или совпадут с ними
+    const char* sql = "SELECT COALESCE(MAX(message_id), 0) FROM messages";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "Failed to read last message id: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    
+    bool success = sqlite3_step(stmt) == SQLITE_ROW;
+    if (success) {
+        message_ids.seed(sqlite3_column_int64(stmt, 0));
+    }
+    
+    sqlite3_finalize(stmt);
+    return success;
+}
+
+bool Database::migrate() {
+    std::lock_guard<std::recursive_mutex> lock(write_mutex);
+    
+    int version = 0;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "PRAGMA user_version", -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        version = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    
+    const int target = static_cast<int>(sizeof(MIGRATIONS) / sizeof(MIGRATIONS[0]));
+    for (int i = version; i < target; i++) {
+        Transaction tx(db);
+        std::string set_version = "PRAGMA user_version = " + std::to_string(i + 1);
+        bool applied = tx.isActive() && execute(MIGRATIONS[i]);
+        // Хеш токена не посчитать в SQL, поэтому перенос сессий - отдельным шагом в той же транзакции
+        if (applied && i + 1 == SESSIONS_MIGRATION) {
+            applied = importLegacySessions();
+        }
+        if (!applied || !execute(set_version.c_str()) || !tx.commit()) {
+            std::cerr << "Migration " << (i + 1) << " failed" << std::endl;
+            if (i + 1 == MESSAGE_SEARCH_MIGRATION && !sqlite3_compileoption_used("ENABLE_FTS5")) {
+                std::cerr << "SQLite " << sqlite3_libversion() << " is built without FTS5, "
+                          << "which message search requires" << std::endl;
+            }
+            return false;
+        }
+        std::cout << "Applied database migration " << (i + 1) << std::endl;
+    }
+    
+    return true;
+}
+
+bool Database::execute(const char* sql) const {
+    char* err_msg = nullptr;
+    if (sqlite3_exec(db, sql, nullptr, nullptr, &err_msg) != SQLITE_OK) {
+        std::cerr << "SQL error: " << (err_msg ? err_msg : sqlite3_errmsg(db)) << std::endl;
+        sqlite3_free(err_msg);
+        return false;
+    }
+    return true;
+}
+
 void Database::close() {
     if (db) {
         sqlite3_close(db);
@@ -89,18 +388,69 @@ void Database::close() {
 }
 
 // User operations
-bool Database::createUser(const std::string& username, const std::string& password_hash, const std::string& email) {
-    const char* sql = "INSERT INTO users (username, password_hash, email) VALUES (?, ?, ?)";
+int Database::createUser(const std::string& username, const std::string& password_hash, const std::string& email) {
+    std::lock_guard<std::recursive_mutex> lock(write_mutex);
+    // Проверка имени и вставка - один оператор: занятое имя не вернёт строку
+    const char* sql =
+        "INSERT INTO users (username, password_hash, email) VALUES (?, ?, ?) "
+        "ON CONFLICT(username) DO NOTHING RETURNING user_id";
     sqlite3_stmt* stmt;
     
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        return false;
+        return -1;
     }
     
     sqlite3_bind_text(stmt, 1, username.c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 2, password_hash.c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 3, email.c_str(), -1, SQLITE_STATIC);
     
+    int user_id = -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        user_id = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    
+    return user_id;
+}
+
+std::vector<std::pair<int, std::string>> Database::getUsernames(const std::vector<int>& user_ids) const {
+    std::vector<std::pair<int, std::string>> names;
+    
+    // Пачками по NAME_BATCH id: один запрос на страницу истории
+    for (std::size_t start = 0; start < user_ids.size(); start += NAME_BATCH) {
+        std::size_t count = std::min(NAME_BATCH, user_ids.size() - start);
+        std::string sql = "SELECT user_id, username FROM users WHERE user_id IN (?";
+        for (std::size_t i = 1; i < count; i++) sql += ",?";
+        sql += ")";
+        
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            return names;
+        }
+        for (std::size_t i = 0; i < count; i++) {
+            sqlite3_bind_int(stmt, static_cast<int>(i + 1), user_ids[start + i]);
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            names.emplace_back(sqlite3_column_int(stmt, 0), columnText(stmt, 1));
+        }
+        sqlite3_finalize(stmt);
+    }
+    
+    return names;
+}
+
+bool Database::updatePasswordHash(int user_id, const std::string& password_hash) {
+    std::lock_guard<std::recursive_mutex> lock(write_mutex);
+    const char* sql = "UPDATE users SET password_hash = ? WHERE user_id = ?";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    
+    sqlite3_bind_text(stmt, 1, password_hash.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, user_id);
+    
     bool success = (sqlite3_step(stmt) == SQLITE_DONE);
     sqlite3_finalize(stmt);
     
@@ -108,7 +458,7 @@ bool Database::createUser(const std::string& username, const std::string& passwo
 }
 
 User* Database::getUserByUsername(const std::string& username) const {
-    const char* sql = "SELECT user_id, username, password_hash, email, session_token FROM users WHERE username = ?";
+    const char* sql = "SELECT user_id, username, password_hash, email FROM users WHERE username = ?";
     sqlite3_stmt* stmt;
     
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
@@ -124,23 +474,61 @@ User* Database::getUserByUsername(const std::string& username) const {
         const unsigned char* username_ptr = sqlite3_column_text(stmt, 1);
         const unsigned char* password_hash_ptr = sqlite3_column_text(stmt, 2);
         const unsigned char* email_ptr = sqlite3_column_text(stmt, 3);
-        const unsigned char* session_token_ptr = sqlite3_column_text(stmt, 4);
         
         std::string username_str = username_ptr ? reinterpret_cast<const char*>(username_ptr) : "";
         std::string password_hash_str = password_hash_ptr ? reinterpret_cast<const char*>(password_hash_ptr) : "";
         std::string email_str = email_ptr ? reinterpret_cast<const char*>(email_ptr) : "";
-        std::string session_token_str = session_token_ptr ? reinterpret_cast<const char*>(session_token_ptr) : "";
         
-        // Создаем пользователя с помощью конструктора для БД
-        user = new User(user_id, username_str, password_hash_str, email_str, session_token_str);
+        // Создаем пользователя с помощью конструктора для БД (сессии - в таблице sessions)
+        user = new User(user_id, username_str, password_hash_str, email_str, "");
     }
     
     sqlite3_finalize(stmt);
     return user;
 }
 
+std::vector<User> Database::getAllUsers() const {
+    std::vector<User> users;
+    
+    // Без password_hash: список нужен для справочников (индекс имён), не для входа
+    const char* sql = "SELECT user_id, username, email FROM users ORDER BY user_id";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return users;
+    }
+    
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        users.emplace_back(sqlite3_column_int(stmt, 0), columnText(stmt, 1), "", columnText(stmt, 2), "");
+    }
+    
+    sqlite3_finalize(stmt);
+    return users;
+}
+
+std::vector<std::pair<int, std::string>> Database::getUsernamesPage(int after_user_id, int limit) const {
+    std::vector<std::pair<int, std::string>> names;
+    
+    const char* sql = "SELECT user_id, username FROM users WHERE user_id > ? ORDER BY user_id LIMIT ?";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return names;
+    }
+    
+    sqlite3_bind_int(stmt, 1, after_user_id);
+    sqlite3_bind_int(stmt, 2, limit);
+    
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        names.emplace_back(sqlite3_column_int(stmt, 0), columnText(stmt, 1));
+    }
+    
+    sqlite3_finalize(stmt);
+    return names;
+}
+
 User* Database::getUserById(int user_id) const {
-    const char* sql = "SELECT user_id, username, password_hash, email, session_token FROM users WHERE user_id = ?";
+    const char* sql = "SELECT user_id, username, password_hash, email FROM users WHERE user_id = ?";
     sqlite3_stmt* stmt;
     
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
@@ -156,32 +544,36 @@ User* Database::getUserById(int user_id) const {
         const unsigned char* username_ptr = sqlite3_column_text(stmt, 1);
         const unsigned char* password_hash_ptr = sqlite3_column_text(stmt, 2);
         const unsigned char* email_ptr = sqlite3_column_text(stmt, 3);
-        const unsigned char* session_token_ptr = sqlite3_column_text(stmt, 4);
         
         // Преобразуем в std::string
         std::string username_str = username_ptr ? reinterpret_cast<const char*>(username_ptr) : "";
         std::string password_hash_str = password_hash_ptr ? reinterpret_cast<const char*>(password_hash_ptr) : "";
         std::string email_str = email_ptr ? reinterpret_cast<const char*>(email_ptr) : "";
-        std::string session_token_str = session_token_ptr ? reinterpret_cast<const char*>(session_token_ptr) : "";
         
-        // Создаем пользователя с помощью конструктора для БД
-        user = new User(db_user_id, username_str, password_hash_str, email_str, session_token_str);
+        // Создаем пользователя с помощью конструктора для БД (сессии - в таблице sessions)
+        user = new User(db_user_id, username_str, password_hash_str, email_str, "");
     }
     
     sqlite3_finalize(stmt);
     return user;
 }
 
-bool Database::updateUserSession(int user_id, const std::string& session_token) {
-    const char* sql = "UPDATE users SET session_token = ? WHERE user_id = ?";
+// Sessions
+bool Database::createSession(const std::string& token_hash, int user_id, const std::string& device, std::int64_t expires_at) {
+    std::lock_guard<std::recursive_mutex> lock(write_mutex);
+    const char* sql = "INSERT INTO sessions (token_hash, user_id, device, created_at, expires_at, last_seen) "
+                      "VALUES (?1, ?2, ?3, ?4, ?5, ?4)";
     sqlite3_stmt* stmt;
     
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
         return false;
     }
     
-    sqlite3_bind_text(stmt, 1, session_token.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 1, token_hash.c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_int(stmt, 2, user_id);
+    sqlite3_bind_text(stmt, 3, device.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 4, unixNow());
+    sqlite3_bind_int64(stmt, 5, expires_at);
     
     bool success = (sqlite3_step(stmt) == SQLITE_DONE);
     sqlite3_finalize(stmt);
@@ -189,50 +581,70 @@ bool Database::updateUserSession(int user_id, const std::string& session_token)
     return success;
 }
 
-// Chat operations
-int Database::createChat(const std::string& chat_name, int creator_id, const std::string& type, bool is_public) {
-    const char* sql = "INSERT INTO chats (chat_name, created_by, chat_type, is_public) VALUES (?, ?, ?, ?)";
+bool Database::getSession(const std::string& token_hash, int& user_id, std::int64_t& expires_at) const {
+    // Один проход по первичному ключу
+    const char* sql = "SELECT user_id, expires_at FROM sessions WHERE token_hash = ? AND expires_at > ?";
     sqlite3_stmt* stmt;
     
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        return -1;
+        return false;
     }
     
-    sqlite3_bind_text(stmt, 1, chat_name.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 2, creator_id);
-    sqlite3_bind_text(stmt, 3, type.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 4, is_public ? 1 : 0);
+    sqlite3_bind_text(stmt, 1, token_hash.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, unixNow());
     
-    if (sqlite3_step(stmt) != SQLITE_DONE) {
-        sqlite3_finalize(stmt);
-        return -1;
+    bool found = false;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        user_id = sqlite3_column_int(stmt, 0);
+        expires_at = sqlite3_column_int64(stmt, 1);
+        found = true;
     }
     
-    int chat_id = sqlite3_last_insert_rowid(db);
     sqlite3_finalize(stmt);
+    return found;
+}
+
+bool Database::touchSessions(const std::vector<std::pair<std::string, std::int64_t>>& last_seen) {
+    if (last_seen.empty()) return true;
+    
+    std::lock_guard<std::recursive_mutex> lock(write_mutex);
+    Transaction tx(db);
+    if (!tx.isActive()) {
+        return false;
+    }
+    
+    const char* sql = "UPDATE sessions SET last_seen = MAX(last_seen, ?) WHERE token_hash = ?";
+    sqlite3_stmt* stmt;
     
-    // Add creator to chat members
-    addUserToChat(creator_id, chat_id);
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
     
-    // If private chat, add creator to whitelist
-    if (!is_public) {
-        addToWhitelist(chat_id, creator_id, creator_id);
+    bool success = true;
+    for (const auto& entry : last_seen) {
+        sqlite3_bind_int64(stmt, 1, entry.second);
+        sqlite3_bind_text(stmt, 2, entry.first.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            success = false;
+            break;
+        }
+        sqlite3_reset(stmt);
     }
     
-    return chat_id;
+    sqlite3_finalize(stmt);
+    return success && tx.commit();
 }
 
-bool Database::addToWhitelist(int chat_id, int user_id, int invited_by) {
-    const char* sql = "INSERT OR REPLACE INTO chat_whitelist (chat_id, user_id, invited_by) VALUES (?, ?, ?)";
+bool Database::deleteSession(const std::string& token_hash) {
+    std::lock_guard<std::recursive_mutex> lock(write_mutex);
+    const char* sql = "DELETE FROM sessions WHERE token_hash = ?";
     sqlite3_stmt* stmt;
     
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
         return false;
     }
     
-    sqlite3_bind_int(stmt, 1, chat_id);
-    sqlite3_bind_int(stmt, 2, user_id);
-    sqlite3_bind_int(stmt, 3, invited_by);
+    sqlite3_bind_text(stmt, 1, token_hash.c_str(), -1, SQLITE_STATIC);
     
     bool success = (sqlite3_step(stmt) == SQLITE_DONE);
     sqlite3_finalize(stmt);
@@ -240,227 +652,597 @@ bool Database::addToWhitelist(int chat_id, int user_id, int invited_by) {
     return success;
 }
 
-bool Database::isUserInWhitelist(int user_id, int chat_id) const {
-    const char* sql = "SELECT 1 FROM chat_whitelist WHERE user_id = ? AND chat_id = ?";
+int Database::deleteExpiredSessions() {
+    std::lock_guard<std::recursive_mutex> lock(write_mutex);
     sqlite3_stmt* stmt;
     
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        return false;
+    if (sqlite3_prepare_v2(db, "DELETE FROM sessions WHERE expires_at <= ?", -1, &stmt, nullptr) != SQLITE_OK) {
+        return -1;
     }
     
-    sqlite3_bind_int(stmt, 1, user_id);
-    sqlite3_bind_int(stmt, 2, chat_id);
-    
-    bool exists = (sqlite3_step(stmt) == SQLITE_ROW);
+    sqlite3_bind_int64(stmt, 1, unixNow());
+    int deleted = sqlite3_step(stmt) == SQLITE_DONE ? sqlite3_changes(db) : -1;
     sqlite3_finalize(stmt);
     
-    return exists;
+    return deleted;
 }
 
-Chat* Database::getChatById(int chat_id) const{
-    const char* sql = "SELECT chat_id, chat_name, chat_type, created_by, is_public FROM chats WHERE chat_id = ?";
+bool Database::importLegacySessions() {
+    // В новых базах колонки session_token уже нет
+    bool has_column = false;
     sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        return nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM pragma_table_info('users') WHERE name = 'session_token'",
+                           -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
     }
+    has_column = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    if (!has_column) return true;
     
-    sqlite3_bind_int(stmt, 1, chat_id);
+    std::vector<std::pair<int, std::string>> tokens;
+    if (sqlite3_prepare_v2(db, "SELECT user_id, session_token FROM users WHERE session_token IS NOT NULL AND session_token <> ''",
+                           -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        tokens.emplace_back(sqlite3_column_int(stmt, 0), columnText(stmt, 1));
+    }
+    sqlite3_finalize(stmt);
     
-    Chat* chat = nullptr;
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        int db_chat_id = sqlite3_column_int(stmt, 0);
-        const unsigned char* chat_name_ptr = sqlite3_column_text(stmt, 1);
-        const unsigned char* chat_type_ptr = sqlite3_column_text(stmt, 2);
-        int created_by = sqlite3_column_int(stmt, 3);
-        bool is_public = sqlite3_column_int(stmt, 4) == 1;
-        
-        std::string chat_name_str = chat_name_ptr ? reinterpret_cast<const char*>(chat_name_ptr) : "";
-        std::string chat_type_str = chat_type_ptr ? reinterpret_cast<const char*>(chat_type_ptr) : "group";
-        
-        chat = new Chat(chat_name_str, created_by, chat_type_str, is_public);
-        chat->chat_id = db_chat_id;
-        
-        // Load members
-        const char* members_sql = "SELECT user_id FROM chat_members WHERE chat_id = ?";
-        sqlite3_stmt* members_stmt;
-        if (sqlite3_prepare_v2(db, members_sql, -1, &members_stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_int(members_stmt, 1, chat->chat_id);
-            while (sqlite3_step(members_stmt) == SQLITE_ROW) {
-                chat->member_ids.push_back(sqlite3_column_int(members_stmt, 0));
-            }
-            sqlite3_finalize(members_stmt);
-        }
-        
-        // Load whitelist for private chats
-        if (!is_public) {
-            const char* whitelist_sql = "SELECT user_id FROM chat_whitelist WHERE chat_id = ?";
-            sqlite3_stmt* whitelist_stmt;
-            if (sqlite3_prepare_v2(db, whitelist_sql, -1, &whitelist_stmt, nullptr) == SQLITE_OK) {
-                sqlite3_bind_int(whitelist_stmt, 1, chat->chat_id);
-                while (sqlite3_step(whitelist_stmt) == SQLITE_ROW) {
-                    chat->whitelist_ids.push_back(sqlite3_column_int(whitelist_stmt, 0));
-                }
-                sqlite3_finalize(whitelist_stmt);
-            }
+    for (const auto& token : tokens) {
+        if (!createSession(SessionSigner::hashToken(token.second), token.first, "legacy", unixNow() + LEGACY_SESSION_TTL)) {
+            return false;
         }
     }
     
-    sqlite3_finalize(stmt);
-    return chat;
+    return execute("ALTER TABLE users DROP COLUMN session_token");
 }
 
-std::vector<Chat> Database::getUserChats(int user_id) const{
-    std::vector<Chat> chats;
-    
-    const char* sql = 
-        "SELECT c.chat_id, c.chat_name, c.chat_type, c.created_by, c.is_public "
-        "FROM chats c "
-        "JOIN chat_members cm ON c.chat_id = cm.chat_id "
-        "WHERE cm.user_id = ? "
-        "ORDER BY c.chat_id DESC";
-    
+bool Database::getSetting(const std::string& key, std::string& value) const {
+    const char* sql = "SELECT value FROM settings WHERE key = ?";
     sqlite3_stmt* stmt;
     
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        return chats;
+        return false;
     }
     
-    sqlite3_bind_int(stmt, 1, user_id);
+    sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_STATIC);
     
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        // Получаем значения из базы данных
-        int chat_id = sqlite3_column_int(stmt, 0);
-        const unsigned char* chat_name_ptr = sqlite3_column_text(stmt, 1);
-        const unsigned char* chat_type_ptr = sqlite3_column_text(stmt, 2);
-        int created_by = sqlite3_column_int(stmt, 3);
-        
-        std::string chat_name_str = chat_name_ptr ? reinterpret_cast<const char*>(chat_name_ptr) : "";
-        std::string chat_type_str = chat_type_ptr ? reinterpret_cast<const char*>(chat_type_ptr) : "group";
-        
-        Chat chat(chat_name_str, created_by, chat_type_str);
-        chat.chat_id = chat_id;
-        
-        // Load members for this chat
-        const char* members_sql = "SELECT user_id FROM chat_members WHERE chat_id = ?";
-        sqlite3_stmt* members_stmt;
-        if (sqlite3_prepare_v2(db, members_sql, -1, &members_stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_int(members_stmt, 1, chat.chat_id);
-            while (sqlite3_step(members_stmt) == SQLITE_ROW) {
-                chat.member_ids.push_back(sqlite3_column_int(members_stmt, 0));
-            }
-            sqlite3_finalize(members_stmt);
-        }
-        
-        chats.push_back(chat);
+    bool found = false;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        value = columnText(stmt, 0);
+        found = true;
     }
     
     sqlite3_finalize(stmt);
-    return chats;
+    return found;
 }
 
-std::vector<Chat> Database::getAllChats() const {
-    std::vector<Chat> chats;
-    
-    const char* sql = "SELECT chat_id, chat_name, chat_type, created_by FROM chats ORDER BY chat_id DESC";
+bool Database::setSetting(const std::string& key, const std::string& value) {
+    std::lock_guard<std::recursive_mutex> lock(write_mutex);
+    const char* sql = "INSERT INTO settings (key, value) VALUES (?, ?) "
+                      "ON CONFLICT(key) DO UPDATE SET value = excluded.value";
     sqlite3_stmt* stmt;
     
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        return chats;
+        return false;
     }
     
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        // Получаем значения из базы данных
-        int chat_id = sqlite3_column_int(stmt, 0);
-        const unsigned char* chat_name_ptr = sqlite3_column_text(stmt, 1);
-        const unsigned char* chat_type_ptr = sqlite3_column_text(stmt, 2);
-        int created_by = sqlite3_column_int(stmt, 3);
-        
-        std::string chat_name_str = chat_name_ptr ? reinterpret_cast<const char*>(chat_name_ptr) : "";
-        std::string chat_type_str = chat_type_ptr ? reinterpret_cast<const char*>(chat_type_ptr) : "group";
-        
-        Chat chat(chat_name_str, created_by, chat_type_str);
-        chat.chat_id = chat_id;
-        
-        // Load members
-        const char* members_sql = "SELECT user_id FROM chat_members WHERE chat_id = ?";
-        sqlite3_stmt* members_stmt;
-        if (sqlite3_prepare_v2(db, members_sql, -1, &members_stmt, nullptr) == SQLITE_OK) {
-            sqlite3_bind_int(members_stmt, 1, chat.chat_id);
-            while (sqlite3_step(members_stmt) == SQLITE_ROW) {
-                chat.member_ids.push_back(sqlite3_column_int(members_stmt, 0));
-            }
-            sqlite3_finalize(members_stmt);
-        }
-        
-        chats.push_back(chat);
-    }
+    sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, value.c_str(), -1, SQLITE_STATIC);
     
+    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
     sqlite3_finalize(stmt);
-    return chats;
+    
+    return success;
 }
 
-// Message operations
-bool Database::addMessage(int chat_id, int sender_id, const std::string& content, const std::string& type) {
-    // Get sender username
-    User* sender = getUserById(sender_id);
-    if (!sender) return false;
-    
-    const char* sql = "INSERT INTO messages (chat_id, sender_id, sender_name, content, message_type) VALUES (?, ?, ?, ?, ?)";
+bool Database::addRevokedSession(const std::string& signature, std::int64_t expires_at) {
+    std::lock_guard<std::recursive_mutex> lock(write_mutex);
+    const char* sql = "INSERT OR IGNORE INTO revoked_sessions (signature, expires_at) VALUES (?, ?)";
     sqlite3_stmt* stmt;
     
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        delete sender;
         return false;
     }
     
-    sqlite3_bind_int(stmt, 1, chat_id);
-    sqlite3_bind_int(stmt, 2, sender_id);
-    sqlite3_bind_text(stmt, 3, sender->username.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 4, content.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 5, type.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 1, signature.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, expires_at);
     
     bool success = (sqlite3_step(stmt) == SQLITE_DONE);
     sqlite3_finalize(stmt);
-    delete sender;
     
     return success;
 }
 
-std::vector<Message> Database::getChatMessages(int chat_id, int limit) const{
-    std::vector<Message> messages;
-    
-    const char* sql = 
-        "SELECT message_id, chat_id, sender_id, sender_name, content, message_type, timestamp "
-        "FROM messages WHERE chat_id = ? ORDER BY message_id ASC LIMIT ?";
+std::vector<std::pair<std::string, std::int64_t>> Database::getRevokedSessions(std::int64_t now) {
+    std::lock_guard<std::recursive_mutex> lock(write_mutex);
+    std::vector<std::pair<std::string, std::int64_t>> revoked;
     
+    // Истёкшие токены не пройдут проверку и без списка - удаляем их
     sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        return messages;
+    if (sqlite3_prepare_v2(db, "DELETE FROM revoked_sessions WHERE expires_at <= ?", -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_int64(stmt, 1, now);
+        sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
     }
     
-    sqlite3_bind_int(stmt, 1, chat_id);
-    sqlite3_bind_int(stmt, 2, limit);
+    if (sqlite3_prepare_v2(db, "SELECT signature, expires_at FROM revoked_sessions", -1, &stmt, nullptr) != SQLITE_OK) {
+        return revoked;
+    }
     
     while (sqlite3_step(stmt) == SQLITE_ROW) {
-        // Получаем значения из базы данных
-        int message_id = sqlite3_column_int(stmt, 0);
-        int db_chat_id = sqlite3_column_int(stmt, 1);
-        int sender_id = sqlite3_column_int(stmt, 2);
-        const unsigned char* sender_name_ptr = sqlite3_column_text(stmt, 3);
-        const unsigned char* content_ptr = sqlite3_column_text(stmt, 4);
-        const unsigned char* message_type_ptr = sqlite3_column_text(stmt, 5);
-        const unsigned char* timestamp_ptr = sqlite3_column_text(stmt, 6);
-        
-        // Преобразуем в std::string
-        std::string sender_name_str = sender_name_ptr ? reinterpret_cast<const char*>(sender_name_ptr) : "";
-        std::string content_str = content_ptr ? reinterpret_cast<const char*>(content_ptr) : "";
-        std::string message_type_str = message_type_ptr ? reinterpret_cast<const char*>(message_type_ptr) : "text";
-        std::string timestamp_str = timestamp_ptr ? reinterpret_cast<const char*>(timestamp_ptr) : "";
+        revoked.emplace_back(columnText(stmt, 0), sqlite3_column_int64(stmt, 1));
+    }
+    
+    sqlite3_finalize(stmt);
+    return revoked;
+}
+
+// Chat operations
+int Database::createChat(const std::string& chat_name, int creator_id, const std::string& type, bool is_public) {
+    std::lock_guard<std::recursive_mutex> lock(write_mutex);
+    // Чат, создатель в участниках, его отметка прочтения и белый список - одна транзакция
+    Transaction tx(db);
+    if (!tx.isActive()) {
+        return -1;
+    }
+    
+    // Строка вставляется, только если создатель существует
+    const char* sql =
+        "INSERT INTO chats (chat_name, created_by, chat_type, is_public, member_count) "
+        "SELECT ?, user_id, ?, ?, 1 FROM users WHERE user_id = ?";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return -1;
+    }
+    
+    sqlite3_bind_text(stmt, 1, chat_name.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, type.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 3, is_public ? 1 : 0);
+    sqlite3_bind_int(stmt, 4, creator_id);
+    
+    bool success = (sqlite3_step(stmt) == SQLITE_DONE) && sqlite3_changes(db) == 1;
+    sqlite3_finalize(stmt);
+    if (!success) {
+        return -1;
+    }
+    int chat_id = static_cast<int>(sqlite3_last_insert_rowid(db));
+    
+    const char* member_sql =
+        "INSERT INTO chat_members (user_id, chat_id, role) VALUES (?, ?, 'admin');";
+    if (sqlite3_prepare_v2(db, member_sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return -1;
+    }
+    sqlite3_bind_int(stmt, 1, creator_id);
+    sqlite3_bind_int(stmt, 2, chat_id);
+    success = (sqlite3_step(stmt) == SQLITE_DONE);
+    sqlite3_finalize(stmt);
+    
+    success = success && resetReadMarker(creator_id, chat_id);
+    if (success && !is_public) {
+        success = addToWhitelist(chat_id, creator_id, creator_id);
+    }
+    
+    if (!success || !tx.commit()) {
+        return -1;
+    }
+    return chat_id;
+}
+
+int Database::findDirectChat(int user_id, int peer_id) const {
+    const char* sql = "SELECT chat_id FROM direct_chats WHERE user_a = ? AND user_b = ?";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return -1;
+    }
+    
+    sqlite3_bind_int(stmt, 1, std::min(user_id, peer_id));
+    sqlite3_bind_int(stmt, 2, std::max(user_id, peer_id));
+    
+    int chat_id = -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        chat_id = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    
+    return chat_id;
+}
+
+int Database::getOrCreateDirectChat(int user_id, int peer_id, bool& created) {
+    created = false;
+    if (user_id == peer_id) {
+        return -1;
+    }
+    
+    // Обычно чат уже есть: поиск по первичному ключу пары, без блокировки записи
+    int chat_id = findDirectChat(user_id, peer_id);
+    if (chat_id != -1) {
+        return chat_id;
+    }
+    
+    std::lock_guard<std::recursive_mutex> lock(write_mutex);
+    // Повторно под блокировкой: параллельный запрос мог создать чат
+    chat_id = findDirectChat(user_id, peer_id);
+    if (chat_id != -1) {
+        return chat_id;
+    }
+    
+    Transaction tx(db);
+    if (!tx.isActive()) {
+        return -1;
+    }
+    
+    // Чат создаётся, только если оба пользователя существуют; имя - пара имён
+    const char* sql =
+        "INSERT INTO chats (chat_name, created_by, chat_type, is_public, member_count) "
+        "SELECT ua.username || ' & ' || ub.username, ua.user_id, 'direct', 0, 2 "
+        "FROM users ua, users ub WHERE ua.user_id = ? AND ub.user_id = ?";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return -1;
+    }
+    
+    sqlite3_bind_int(stmt, 1, user_id);
+    sqlite3_bind_int(stmt, 2, peer_id);
+    
+    bool success = (sqlite3_step(stmt) == SQLITE_DONE) && sqlite3_changes(db) == 1;
+    sqlite3_finalize(stmt);
+    if (!success) {
+        return -1;
+    }
+    chat_id = static_cast<int>(sqlite3_last_insert_rowid(db));
+    
+    const char* members_sql =
+        "INSERT INTO chat_members (user_id, chat_id) VALUES (?1, ?3), (?2, ?3)";
+    if (sqlite3_prepare_v2(db, members_sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return -1;
+    }
+    sqlite3_bind_int(stmt, 1, user_id);
+    sqlite3_bind_int(stmt, 2, peer_id);
+    sqlite3_bind_int(stmt, 3, chat_id);
+    success = (sqlite3_step(stmt) == SQLITE_DONE);
+    sqlite3_finalize(stmt);
+    
+    const char* pair_sql = "INSERT INTO direct_chats (user_a, user_b, chat_id) VALUES (?, ?, ?)";
+    if (success && sqlite3_prepare_v2(db, pair_sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_int(stmt, 1, std::min(user_id, peer_id));
+        sqlite3_bind_int(stmt, 2, std::max(user_id, peer_id));
+        sqlite3_bind_int(stmt, 3, chat_id);
+        success = (sqlite3_step(stmt) == SQLITE_DONE);
+        sqlite3_finalize(stmt);
+    } else {
+        success = false;
+    }
+    
+    success = success && resetReadMarker(user_id, chat_id) && resetReadMarker(peer_id, chat_id);
+    if (!success || !tx.commit()) {
+        return -1;
+    }
+    
+    created = true;
+    return chat_id;
+}
+
+bool Database::addToWhitelist(int chat_id, int user_id, int invited_by) {
+    std::lock_guard<std::recursive_mutex> lock(write_mutex);
+    // Повторное приглашение обновляет строку на месте, без DELETE + INSERT
+    const char* sql =
+        "INSERT INTO chat_whitelist (chat_id, user_id, invited_by) VALUES (?, ?, ?) "
+        "ON CONFLICT(chat_id, user_id) DO UPDATE SET invited_by = excluded.invited_by, invited_at = CURRENT_TIMESTAMP";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    
+    sqlite3_bind_int(stmt, 1, chat_id);
+    sqlite3_bind_int(stmt, 2, user_id);
+    sqlite3_bind_int(stmt, 3, invited_by);
+    
+    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
+    sqlite3_finalize(stmt);
+    
+    return success;
+}
+
+bool Database::isUserInWhitelist(int user_id, int chat_id) const {
+    const char* sql = "SELECT 1 FROM chat_whitelist WHERE user_id = ? AND chat_id = ?";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    
+    sqlite3_bind_int(stmt, 1, user_id);
+    sqlite3_bind_int(stmt, 2, chat_id);
+    
+    bool exists = (sqlite3_step(stmt) == SQLITE_ROW);
+    sqlite3_finalize(stmt);
+    
+    return exists;
+}
+
+Chat* Database::getChatById(int chat_id) const{
+    const char* sql = "SELECT " CHAT_COLUMNS "FROM chats c WHERE c.chat_id = ?";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return nullptr;
+    }
+    
+    sqlite3_bind_int(stmt, 1, chat_id);
+    
+    Chat* chat = nullptr;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        // Участники и белый список не загружаются
+        chat = new Chat(readChat(stmt));
+    }
+    
+    sqlite3_finalize(stmt);
+    return chat;
+}
+
+std::vector<Chat> Database::getUserChats(int user_id) const{
+    std::vector<Chat> chats;
+    
+    // member_count и последнее сообщение хранятся в chats - один проход без подзапросов
+    const char* sql = 
+        "SELECT " CHAT_COLUMNS
+        "FROM chat_members cm "
+        "JOIN chats c ON c.chat_id = cm.chat_id "
+        "WHERE cm.user_id = ? "
+        "ORDER BY c.last_message_at DESC, c.chat_id DESC";
+    
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return chats;
+    }
+    
+    sqlite3_bind_int(stmt, 1, user_id);
+    
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        chats.push_back(readChat(stmt));
+    }
+    
+    sqlite3_finalize(stmt);
+    return chats;
+}
+
+std::vector<Chat> Database::getAllChats() const {
+    std::vector<Chat> chats;
+    
+    const char* sql = 
+        "SELECT " CHAT_COLUMNS
+        "FROM chats c "
+        "ORDER BY c.last_message_at DESC, c.chat_id DESC";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return chats;
+    }
+    
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        chats.push_back(readChat(stmt));
+    }
+    
+    sqlite3_finalize(stmt);
+    return chats;
+}
+
+std::vector<Chat> Database::getPublicChats(DirectorySort sort, std::int64_t after_value, int after_chat_id, int limit) const {
+    std::vector<Chat> chats;
+    
+    // Страница начинается строго после (значение, chat_id) последнего чата предыдущей:
+    // чтение идёт по частичному индексу и не зависит от числа чатов
+    const char* sql = sort == DIRECTORY_BY_MEMBERS
+        ? "SELECT " CHAT_COLUMNS "FROM chats c "
+          "WHERE c.is_public = 1 AND (c.member_count, c.chat_id) < (?, ?) "
+          "ORDER BY c.member_count DESC, c.chat_id DESC LIMIT ?"
+        : "SELECT " CHAT_COLUMNS "FROM chats c "
+          // По индексу на выражение SQLite ищет только при раскрытом сравнении, не row value
+          "WHERE c.is_public = 1 AND COALESCE(c.last_message_at, 0) <= ?1 "
+          "AND (COALESCE(c.last_message_at, 0) < ?1 OR c.chat_id < ?2) "
+          "ORDER BY COALESCE(c.last_message_at, 0) DESC, c.chat_id DESC LIMIT ?3";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "ERROR in getPublicChats: " << sqlite3_errmsg(db) << std::endl;
+        return chats;
+    }
+    
+    sqlite3_bind_int64(stmt, 1, after_value);
+    sqlite3_bind_int(stmt, 2, after_chat_id);
+    sqlite3_bind_int(stmt, 3, limit);
+    
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        chats.push_back(readChat(stmt));
+    }
+    
+    sqlite3_finalize(stmt);
+    return chats;
+}
+
+std::vector<int> Database::getChatMemberIds(int chat_id) const {
+    std::vector<int> member_ids;
+    
+    const char* sql = "SELECT user_id FROM chat_members WHERE chat_id = ?";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return member_ids;
+    }
+    
+    sqlite3_bind_int(stmt, 1, chat_id);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        member_ids.push_back(sqlite3_column_int(stmt, 0));
+    }
+    
+    sqlite3_finalize(stmt);
+    return member_ids;
+}
+
+std::vector<int> Database::getChatMemberIdsPage(int chat_id, int after_user_id, int limit) const {
+    std::vector<int> member_ids;
+    
+    // Keyset-пагинация по индексу (chat_id, user_id): страница не зависит от размера чата
+    const char* sql =
+        "SELECT user_id FROM chat_members WHERE chat_id = ? AND user_id > ? "
+        "ORDER BY user_id LIMIT ?";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return member_ids;
+    }
+    
+    sqlite3_bind_int(stmt, 1, chat_id);
+    sqlite3_bind_int(stmt, 2, after_user_id);
+    sqlite3_bind_int(stmt, 3, limit);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        member_ids.push_back(sqlite3_column_int(stmt, 0));
+    }
+    
+    sqlite3_finalize(stmt);
+    return member_ids;
+}
+
+std::vector<int> Database::getChannelIds() const {
+    std::vector<int> chat_ids;
+    
+    const char* sql = "SELECT chat_id FROM chats WHERE chat_type = 'channel'";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return chat_ids;
+    }
+    
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        chat_ids.push_back(sqlite3_column_int(stmt, 0));
+    }
+    
+    sqlite3_finalize(stmt);
+    return chat_ids;
+}
+
+std::vector<int> Database::getUserChatIds(int user_id) const {
+    std::vector<int> chat_ids;
+    
+    const char* sql = "SELECT chat_id FROM chat_members WHERE user_id = ?";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return chat_ids;
+    }
+    
+    sqlite3_bind_int(stmt, 1, user_id);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        chat_ids.push_back(sqlite3_column_int(stmt, 0));
+    }
+    
+    sqlite3_finalize(stmt);
+    return chat_ids;
+}
+
+// Message operations
+Message* Database::addMessage(int chat_id, int sender_id, const std::string& content, const std::string& type) {
+    std::lock_guard<std::recursive_mutex> lock(write_mutex);
+    Transaction tx(db);
+    if (!tx.isActive()) {
+        return nullptr;
+    }
+    
+    // Время ставим сами, чтобы вернуть сообщение без повторного SELECT.
+    // sender_name не хранится - его заполняет вызывающий (UserNames)
+    Message* message = new Message(0, chat_id, sender_id, "", content, type);
+    message->timestamp = Message::nowMillis();
+    
+    // id берётся из генератора под write_mutex: порядок id совпадает с порядком записи на узле
+    message->message_id = message_ids.next();
+    
+    const char* sql = "INSERT INTO messages (message_id, chat_id, sender_id, content, message_type, timestamp) VALUES (?, ?, ?, ?, ?, ?)";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        delete message;
+        return nullptr;
+    }
+    
+    sqlite3_bind_int64(stmt, 1, message->message_id);
+    sqlite3_bind_int(stmt, 2, chat_id);
+    sqlite3_bind_int(stmt, 3, sender_id);
+    sqlite3_bind_text(stmt, 4, content.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 5, type.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 6, message->timestamp);
+    
+    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
+    sqlite3_finalize(stmt);
+    if (!success) {
+        delete message;
+        return nullptr;
+    }
+    
+    // Последнее сообщение чата обновляется в той же транзакции
+    std::string preview = makePreview(content);
+    const char* update_sql =
+        "UPDATE chats SET last_message_id = ?, last_message_at = ?, last_message_preview = ? "
+        "WHERE chat_id = ?";
+    
+    if (sqlite3_prepare_v2(db, update_sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        delete message;
+        return nullptr;
+    }
+    
+    sqlite3_bind_int64(stmt, 1, message->message_id);
+    sqlite3_bind_int64(stmt, 2, message->timestamp);
+    sqlite3_bind_text(stmt, 3, preview.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 4, chat_id);
+    
+    success = (sqlite3_step(stmt) == SQLITE_DONE);
+    sqlite3_finalize(stmt);
+    
+    if (!success || !tx.commit()) {
+        delete message;
+        return nullptr;
+    }
+    return message;
+}
+
+std::vector<Message> Database::getChatMessages(int chat_id, int limit) const{
+    std::vector<Message> messages;
+    
+    const char* sql = 
+        "SELECT * FROM ("
+        "SELECT message_id, chat_id, sender_id, content, message_type, timestamp "
+        "FROM messages WHERE chat_id = ? ORDER BY message_id DESC LIMIT ?"
+        ") ORDER BY message_id ASC"; // последние limit сообщений, по порядку
+    
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return messages;
+    }
+    
+    sqlite3_bind_int(stmt, 1, chat_id);
+    sqlite3_bind_int(stmt, 2, limit);
+    
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        // Получаем значения из базы данных
+        std::int64_t message_id = sqlite3_column_int64(stmt, 0);
+        int db_chat_id = sqlite3_column_int(stmt, 1);
+        int sender_id = sqlite3_column_int(stmt, 2);
+        const unsigned char* content_ptr = sqlite3_column_text(stmt, 3);
+        const unsigned char* message_type_ptr = sqlite3_column_text(stmt, 4);
+        
+        // Преобразуем в std::string
+        std::string content_str = content_ptr ? reinterpret_cast<const char*>(content_ptr) : "";
+        std::string message_type_str = message_type_ptr ? reinterpret_cast<const char*>(message_type_ptr) : "text";
         
-        Message msg(message_id, db_chat_id, sender_id, sender_name_str, content_str, message_type_str);
-        msg.timestamp = timestamp_str;
+        Message msg(message_id, db_chat_id, sender_id, "", content_str, message_type_str); // имя - UserNames
+        msg.timestamp = sqlite3_column_int64(stmt, 5);
         messages.push_back(msg);
     }
     
@@ -468,63 +1250,167 @@ std::vector<Message> Database::getChatMessages(int chat_id, int limit) const{
     return messages;
 }
 
+std::vector<Message> Database::searchMessages(int user_id, const std::string& text, int chat_id, int limit, int offset) const {
+    std::vector<Message> results;
+    std::string query = ftsQuery(text);
+    if (query.empty()) {
+        return results;
+    }
+    
+    // Совпадения из индекса FTS5 фильтруются чатами пользователя (ключ chat_members)
+    // и сортируются по релевантности (bm25), при равной - сначала новые
+    const char* sql =
+        "SELECT m.message_id, m.chat_id, m.sender_id, "
+        "snippet(messages_fts, 0, '[', ']', '...', 12), m.message_type, m.timestamp "
+        "FROM messages_fts JOIN messages m ON m.message_id = messages_fts.rowid "
+        "WHERE messages_fts MATCH ?1 "
+        "AND m.chat_id IN (SELECT chat_id FROM chat_members WHERE user_id = ?2) "
+        "AND (?3 = 0 OR m.chat_id = ?3) "
+        "ORDER BY messages_fts.rank, m.message_id DESC LIMIT ?4 OFFSET ?5";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "ERROR in searchMessages: " << sqlite3_errmsg(db) << std::endl;
+        return results;
+    }
+    
+    sqlite3_bind_text(stmt, 1, query.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 2, user_id);
+    sqlite3_bind_int(stmt, 3, chat_id);
+    sqlite3_bind_int(stmt, 4, limit);
+    sqlite3_bind_int(stmt, 5, offset);
+    
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        // content - фрагмент с выделенными совпадениями, имя заполняет вызывающий
+        Message msg(sqlite3_column_int64(stmt, 0), sqlite3_column_int(stmt, 1), sqlite3_column_int(stmt, 2),
+                    "", columnText(stmt, 3), columnText(stmt, 4, "text"));
+        msg.timestamp = sqlite3_column_int64(stmt, 5);
+        results.push_back(msg);
+    }
+    
+    sqlite3_finalize(stmt);
+    return results;
+}
 
-bool Database::addUserToChat(int user_id, int chat_id) {
-    // Сначала проверяем существование пользователя и чата
-    User* user = getUserById(user_id);
-    if (!user) {
-        std::cerr << "ERROR in addUserToChat: User " << user_id << " not found!" << std::endl;
-        return false;
+std::int64_t Database::getLastMessageId(int chat_id) const {
+    const char* sql = "SELECT COALESCE(last_message_id, 0) FROM chats WHERE chat_id = ?";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return 0;
     }
-    delete user;
     
-    // Проверяем существование чата
-    const char* check_chat_sql = "SELECT 1 FROM chats WHERE chat_id = ?";
-    sqlite3_stmt* check_stmt;
+    sqlite3_bind_int(stmt, 1, chat_id);
     
-    if (sqlite3_prepare_v2(db, check_chat_sql, -1, &check_stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "ERROR in addUserToChat: Failed to prepare check statement" << std::endl;
-        return false;
+    std::int64_t message_id = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        message_id = sqlite3_column_int64(stmt, 0);
     }
     
-    sqlite3_bind_int(check_stmt, 1, chat_id);
-    bool chat_exists = (sqlite3_step(check_stmt) == SQLITE_ROW);
-    sqlite3_finalize(check_stmt);
+    sqlite3_finalize(stmt);
+    return message_id;
+}
+
+int Database::countMessagesAfter(int chat_id, std::int64_t message_id) const {
+    const char* sql = "SELECT COUNT(*) FROM messages WHERE chat_id = ? AND message_id > ?";
+    sqlite3_stmt* stmt;
     
-    if (!chat_exists) {
-        std::cerr << "ERROR in addUserToChat: Chat " << chat_id << " not found!" << std::endl;
-        return false;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return 0;
     }
     
-    // Основной запрос на добавление
-    const char* sql = "INSERT OR IGNORE INTO chat_members (user_id, chat_id) VALUES (?, ?)";
+    sqlite3_bind_int(stmt, 1, chat_id);
+    sqlite3_bind_int64(stmt, 2, message_id);
+    
+    int count = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        count = sqlite3_column_int(stmt, 0);
+    }
+    
+    sqlite3_finalize(stmt);
+    return count;
+}
+
+JoinResult Database::addUserToChat(int user_id, int chat_id) {
+    std::lock_guard<std::recursive_mutex> lock(write_mutex);
+    Transaction tx(db);
+    if (!tx.isActive()) {
+        return JOIN_FAILED;
+    }
+    
+    // Существование пользователя и чата, доступ к приватному чату и повторное вступление
+    // проверяются в самой вставке: между проверкой и записью ничего не может измениться
+    const char* sql =
+        "INSERT INTO chat_members (user_id, chat_id) "
+        "SELECT u.user_id, c.chat_id FROM users u, chats c "
+        "WHERE u.user_id = ? AND c.chat_id = ? AND c.chat_type <> 'direct' AND (c.is_public = 1 OR EXISTS ("
+        "SELECT 1 FROM chat_whitelist w WHERE w.chat_id = c.chat_id AND w.user_id = u.user_id)) "
+        "ON CONFLICT(user_id, chat_id) DO NOTHING";
     sqlite3_stmt* stmt;
     
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
         std::cerr << "ERROR in addUserToChat: Failed to prepare statement for user " 
                   << user_id << " chat " << chat_id 
                   << ". Error: " << sqlite3_errmsg(db) << std::endl;
-        return false;
+        return JOIN_FAILED;
     }
     
     sqlite3_bind_int(stmt, 1, user_id);
     sqlite3_bind_int(stmt, 2, chat_id);
     
     bool success = (sqlite3_step(stmt) == SQLITE_DONE);
-    
+    sqlite3_finalize(stmt);
     if (!success) {
         std::cerr << "ERROR in addUserToChat: Failed to execute. SQLite error: " 
                   << sqlite3_errmsg(db) << std::endl;
-    } else {
-        std::cout << "SUCCESS in addUserToChat: Added user " << user_id 
-                  << " to chat " << chat_id << std::endl;
+        return JOIN_FAILED;
+    }
+    
+    if (sqlite3_changes(db) == 0) {
+        // Ничего не вставлено - выясняем причину (только на этом пути)
+        return joinFailureReason(user_id, chat_id);
+    }
+    
+    if (!updateMemberCount(chat_id, 1) || !resetReadMarker(user_id, chat_id) || !tx.commit()) {
+        std::cerr << "ERROR in addUserToChat: Failed to execute. SQLite error: " 
+                  << sqlite3_errmsg(db) << std::endl;
+        return JOIN_FAILED;
+    }
+    
+    std::cout << "SUCCESS in addUserToChat: Added user " << user_id 
+              << " to chat " << chat_id << std::endl;
+    return JOIN_OK;
+}
+
+JoinResult Database::joinFailureReason(int user_id, int chat_id) const {
+    const char* sql =
+        "SELECT EXISTS (SELECT 1 FROM users WHERE user_id = ?1), c.is_public, "
+        "EXISTS (SELECT 1 FROM chat_members WHERE user_id = ?1 AND chat_id = c.chat_id) "
+        "FROM chats c WHERE c.chat_id = ?2";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return JOIN_FAILED;
     }
     
+    sqlite3_bind_int(stmt, 1, user_id);
+    sqlite3_bind_int(stmt, 2, chat_id);
+    
+    JoinResult result = JOIN_NOT_FOUND;
+    if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0) == 1) {
+        result = sqlite3_column_int(stmt, 2) == 1 ? JOIN_ALREADY_MEMBER : JOIN_FORBIDDEN;
+    }
     sqlite3_finalize(stmt);
-    return success;
+    return result;
 }
 
 bool Database::removeUserFromChat(int user_id, int chat_id) {
+    std::lock_guard<std::recursive_mutex> lock(write_mutex);
+    Transaction tx(db);
+    if (!tx.isActive()) {
+        return false;
+    }
+    
     const char* sql = "DELETE FROM chat_members WHERE user_id = ? AND chat_id = ?";
     sqlite3_stmt* stmt;
     
@@ -538,38 +1424,151 @@ bool Database::removeUserFromChat(int user_id, int chat_id) {
     bool success = (sqlite3_step(stmt) == SQLITE_DONE);
     sqlite3_finalize(stmt);
     
+    if (success && sqlite3_changes(db) > 0) {
+        success = updateMemberCount(chat_id, -1) && deleteReadMarker(user_id, chat_id);
+    }
+    
+    return success && tx.commit();
+}
+
+bool Database::updateMemberCount(int chat_id, int delta) {
+    const char* sql = "UPDATE chats SET member_count = member_count + ? WHERE chat_id = ?";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    
+    sqlite3_bind_int(stmt, 1, delta);
+    sqlite3_bind_int(stmt, 2, chat_id);
+    
+    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
+    sqlite3_finalize(stmt);
+    
+    return success;
+}
+
+// Новый участник начинает с прочитанной историей
+bool Database::resetReadMarker(int user_id, int chat_id) {
+    const char* sql =
+        "INSERT OR REPLACE INTO read_markers (user_id, chat_id, last_read_message_id) "
+        "SELECT ?, chat_id, COALESCE(last_message_id, 0) FROM chats WHERE chat_id = ?";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    
+    sqlite3_bind_int(stmt, 1, user_id);
+    sqlite3_bind_int(stmt, 2, chat_id);
+    
+    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
+    sqlite3_finalize(stmt);
+    
     return success;
 }
-User* Database::getUserBySession(const std::string& session_token) const {
-    const char* sql = "SELECT user_id, username, password_hash, email, session_token FROM users WHERE session_token = ?";
+
+bool Database::deleteReadMarker(int user_id, int chat_id) {
+    const char* sql = "DELETE FROM read_markers WHERE user_id = ? AND chat_id = ?";
     sqlite3_stmt* stmt;
     
     if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        return nullptr;
+        return false;
     }
     
-    sqlite3_bind_text(stmt, 1, session_token.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 1, user_id);
+    sqlite3_bind_int(stmt, 2, chat_id);
     
-    User* user = nullptr;
+    bool success = (sqlite3_step(stmt) == SQLITE_DONE);
+    sqlite3_finalize(stmt);
+    
+    return success;
+}
+
+std::int64_t Database::getReadMarker(int user_id, int chat_id) const {
+    const char* sql = "SELECT last_read_message_id FROM read_markers WHERE user_id = ? AND chat_id = ?";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return 0;
+    }
+    
+    sqlite3_bind_int(stmt, 1, user_id);
+    sqlite3_bind_int(stmt, 2, chat_id);
+    
+    std::int64_t message_id = 0;
     if (sqlite3_step(stmt) == SQLITE_ROW) {
-        // Получаем значения из базы данных
-        int user_id = sqlite3_column_int(stmt, 0);
-        const unsigned char* username_ptr = sqlite3_column_text(stmt, 1);
-        const unsigned char* password_hash_ptr = sqlite3_column_text(stmt, 2);
-        const unsigned char* email_ptr = sqlite3_column_text(stmt, 3);
-        const unsigned char* session_token_ptr = sqlite3_column_text(stmt, 4);
-        
-        std::string username_str = username_ptr ? reinterpret_cast<const char*>(username_ptr) : "";
-        std::string password_hash_str = password_hash_ptr ? reinterpret_cast<const char*>(password_hash_ptr) : "";
-        std::string email_str = email_ptr ? reinterpret_cast<const char*>(email_ptr) : "";
-        std::string session_token_str = session_token_ptr ? reinterpret_cast<const char*>(session_token_ptr) : "";
-        
-        // Создаем пользователя с помощью конструктора для БД
-        user = new User(user_id, username_str, password_hash_str, email_str, session_token_str);
+        message_id = sqlite3_column_int64(stmt, 0);
     }
     
     sqlite3_finalize(stmt);
-    return user;
+    return message_id;
+}
+
+std::vector<ReadMarker> Database::getReadMarkers(int user_id) const {
+    std::vector<ReadMarker> markers;
+    
+    // Непрочитанные считаются по индексу (chat_id, message_id)
+    const char* sql =
+        "SELECT r.chat_id, r.last_read_message_id, "
+        "(SELECT COUNT(*) FROM messages m WHERE m.chat_id = r.chat_id AND m.message_id > r.last_read_message_id) "
+        "FROM read_markers r WHERE r.user_id = ?";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return markers;
+    }
+    
+    sqlite3_bind_int(stmt, 1, user_id);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        ReadMarker marker;
+        marker.user_id = user_id;
+        marker.chat_id = sqlite3_column_int(stmt, 0);
+        marker.last_read_message_id = sqlite3_column_int64(stmt, 1);
+        marker.unread_count = sqlite3_column_int(stmt, 2);
+        markers.push_back(marker);
+    }
+    
+    sqlite3_finalize(stmt);
+    return markers;
+}
+
+bool Database::saveReadMarkers(const std::vector<ReadMarker>& markers) {
+    if (markers.empty()) return true;
+    
+    std::lock_guard<std::recursive_mutex> lock(write_mutex);
+    Transaction tx(db);
+    if (!tx.isActive()) {
+        return false;
+    }
+    
+    // Отметка только растёт; вышедшим из чата не пишем
+    const char* sql =
+        "INSERT INTO read_markers (user_id, chat_id, last_read_message_id) "
+        "SELECT ?1, ?2, ?3 WHERE EXISTS "
+        "(SELECT 1 FROM chat_members WHERE user_id = ?1 AND chat_id = ?2) "
+        "ON CONFLICT(user_id, chat_id) DO UPDATE SET "
+        "last_read_message_id = MAX(last_read_message_id, excluded.last_read_message_id)";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    
+    bool success = true;
+    for (const auto& marker : markers) {
+        sqlite3_bind_int(stmt, 1, marker.user_id);
+        sqlite3_bind_int(stmt, 2, marker.chat_id);
+        sqlite3_bind_int64(stmt, 3, marker.last_read_message_id);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            success = false;
+            break;
+        }
+        sqlite3_reset(stmt);
+    }
+    
+    sqlite3_finalize(stmt);
+    return success && tx.commit();
 }
 
 bool Database::isUserInChat(int user_id, int chat_id) const {
@@ -587,4 +1586,61 @@ bool Database::isUserInChat(int user_id, int chat_id) const {
     sqlite3_finalize(stmt);
     
     return exists;
+}
+
+bool Database::canPost(int user_id, int chat_id) const {
+    // Участник любого чата, кроме канала; в канале - только admin
+    const char* sql =
+        "SELECT 1 FROM chat_members cm JOIN chats c ON c.chat_id = cm.chat_id "
+        "WHERE cm.user_id = ? AND cm.chat_id = ? AND (c.chat_type <> 'channel' OR cm.role = 'admin')";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    
+    sqlite3_bind_int(stmt, 1, user_id);
+    sqlite3_bind_int(stmt, 2, chat_id);
+    
+    bool allowed = (sqlite3_step(stmt) == SQLITE_ROW);
+    sqlite3_finalize(stmt);
+    
+    return allowed;
+}
+
+bool Database::isChatAdmin(int user_id, int chat_id) const {
+    const char* sql = "SELECT 1 FROM chat_members WHERE user_id = ? AND chat_id = ? AND role = 'admin'";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    
+    sqlite3_bind_int(stmt, 1, user_id);
+    sqlite3_bind_int(stmt, 2, chat_id);
+    
+    bool admin = (sqlite3_step(stmt) == SQLITE_ROW);
+    sqlite3_finalize(stmt);
+    
+    return admin;
+}
+
+bool Database::setMemberRole(int user_id, int chat_id, const std::string& role) {
+    std::lock_guard<std::recursive_mutex> lock(write_mutex);
+    const char* sql = "UPDATE chat_members SET role = ? WHERE user_id = ? AND chat_id = ?";
+    sqlite3_stmt* stmt;
+    
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return false;
+    }
+    
+    sqlite3_bind_text(stmt, 1, role.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, user_id);
+    sqlite3_bind_int(stmt, 3, chat_id);
+    
+    // Только существующий участник: строка должна найтись
+    bool success = (sqlite3_step(stmt) == SQLITE_DONE) && sqlite3_changes(db) == 1;
+    sqlite3_finalize(stmt);
+    
+    return success;
 }
\ No newline at end of file
@@ -2,14 +2,53 @@
 #include <sqlite3.h>
 #include <string>
 #include <vector>
+#include <mutex>
+#include <cstdint>
+#include <utility>
 #include "user.h"
 #include "chat.h"
 #include "message.h"
+#include "snowflake.h"
+
+// Транзакция через SAVEPOINT: вложенные вызовы (createChat -> addUserToChat) не конфликтуют.
+// Если commit() не вызван, изменения откатываются в деструкторе.
+class Transaction {
+public:
+    explicit Transaction(sqlite3* db);
+    ~Transaction();
+    
+    Transaction(const Transaction&) = delete;
+    Transaction& operator=(const Transaction&) = delete;
+    
+    bool commit();
+    bool isActive() const { return active; }
+    
+private:
+    sqlite3* db;
+    bool active;
+};
+
+// Отметка прочтения: пользователь прочитал чат до last_read_message_id включительно
+struct ReadMarker {
+    int user_id;
+    int chat_id;
+    std::int64_t last_read_message_id;
+    int unread_count; // заполняется только getReadMarkers
+};
+
+// Порядок каталога публичных чатов (getPublicChats), по убыванию
+enum DirectorySort { DIRECTORY_BY_MEMBERS, DIRECTORY_BY_ACTIVITY };
+
+// Итог addUserToChat
+enum JoinResult { JOIN_OK, JOIN_ALREADY_MEMBER, JOIN_FORBIDDEN, JOIN_NOT_FOUND, JOIN_FAILED };
 
 class Database {
 private:
     sqlite3* db;
     std::string db_path;
+    // Одно соединение на все потоки: запись и last_insert_rowid должны идти атомарно
+    std::recursive_mutex write_mutex;
+    SnowflakeGenerator message_ids; // id сообщений известны до вставки, см. addMessage
     
 public:
     Database(const std::string& path);
@@ -18,34 +57,83 @@ public:
     bool initialize();
     
     // User operations
-    bool createUser(const std::string& username, const std::string& password_hash, const std::string& email);
+    int createUser(const std::string& username, const std::string& password_hash, const std::string& email); // user_id или -1 (имя занято)
     User* getUserByUsername(const std::string& username) const;
     User* getUserById(int user_id) const;
-    User* getUserBySession(const std::string& session_token) const;
-    bool updateUserSession(int user_id, const std::string& session_token);
+    bool updatePasswordHash(int user_id, const std::string& password_hash);
+    std::vector<std::pair<int, std::string>> getUsernames(const std::vector<int>& user_ids) const; // (user_id, username)
+    // Страница (user_id, username) по возрастанию user_id, строго после after_user_id
+    std::vector<std::pair<int, std::string>> getUsernamesPage(int after_user_id, int limit) const;
+    
+    // Сессии: по строке на устройство, токен хранится только хешем (SessionSigner::hashToken)
+    bool createSession(const std::string& token_hash, int user_id, const std::string& device, std::int64_t expires_at);
+    bool getSession(const std::string& token_hash, int& user_id, std::int64_t& expires_at) const; // только неистёкшие
+    bool touchSessions(const std::vector<std::pair<std::string, std::int64_t>>& last_seen); // пачкой, одной транзакцией
+    bool deleteSession(const std::string& token_hash);
+    int deleteExpiredSessions();
+    
+    // Настройки сервера (ключ-значение)
+    bool getSetting(const std::string& key, std::string& value) const;
+    bool setSetting(const std::string& key, const std::string& value);
+    
+    // Отозванные подписанные токены; getRevokedSessions заодно удаляет истёкшие
+    bool addRevokedSession(const std::string& signature, std::int64_t expires_at);
+    std::vector<std::pair<std::string, std::int64_t>> getRevokedSessions(std::int64_t now);
     
     // Chat operations  
     int createChat(const std::string& chat_name, int creator_id, const std::string& type = "group", bool is_public = true);
     Chat* getChatById(int chat_id) const;
     std::vector<Chat> getUserChats(int user_id) const;
     std::vector<Chat> getAllChats() const;
+    // Страница публичных чатов после (after_value, after_chat_id): member_count или
+    // last_message_at (0 - нет сообщений) и chat_id последнего чата предыдущей страницы
+    std::vector<Chat> getPublicChats(DirectorySort sort, std::int64_t after_value, int after_chat_id, int limit) const;
+    std::vector<int> getChatMemberIds(int chat_id) const;
+    std::vector<int> getChatMemberIdsPage(int chat_id, int after_user_id, int limit) const; // по возрастанию user_id
+    std::vector<int> getChannelIds() const;
+    // Личный чат пары (chat_type "direct"): находит по ключу пары или создаёт; -1 - нет пользователя
+    int getOrCreateDirectChat(int user_id, int peer_id, bool& created);
+    int findDirectChat(int user_id, int peer_id) const; // -1 - чата нет
+    std::vector<int> getUserChatIds(int user_id) const;
     
     // Whitelist operations - для приватных чатов
     bool addToWhitelist(int chat_id, int user_id, int invited_by);
     bool isUserInWhitelist(int user_id, int chat_id) const;
     
     // Message operations
-    bool addMessage(int chat_id, int sender_id, const std::string& content, const std::string& type = "text");
+    Message* addMessage(int chat_id, int sender_id, const std::string& content, const std::string& type = "text");
     std::vector<Message> getChatMessages(int chat_id, int limit = 50) const;
+    // Полнотекстовый поиск по чатам пользователя (chat_id = 0 - по всем); в content - фрагмент
+    // с совпадениями в [квадратных скобках], sender_name не заполнен
+    std::vector<Message> searchMessages(int user_id, const std::string& text, int chat_id, int limit, int offset) const;
+    std::int64_t getLastMessageId(int chat_id) const;
+    int countMessagesAfter(int chat_id, std::int64_t message_id) const;
+    
+    // Read markers
+    std::int64_t getReadMarker(int user_id, int chat_id) const;
+    std::vector<ReadMarker> getReadMarkers(int user_id) const; // с подсчитанным unread_count
+    bool saveReadMarkers(const std::vector<ReadMarker>& markers);
     
     // Membership operations
-    bool addUserToChat(int user_id, int chat_id);
+    // Только в публичный чат или по приглашению (в личные - никогда); проверки и вставка - одна транзакция
+    JoinResult addUserToChat(int user_id, int chat_id);
     bool removeUserFromChat(int user_id, int chat_id);
     bool isUserInChat(int user_id, int chat_id) const;
+    bool canPost(int user_id, int chat_id) const; // участник, а в канале - admin
+    bool isChatAdmin(int user_id, int chat_id) const;
+    bool setMemberRole(int user_id, int chat_id, const std::string& role); // "admin" / "member"
     
     // Utility
-    std::vector<User> getAllUsers() const;
+    std::vector<User> getAllUsers() const; // без password_hash
     
 private:
     void close();
+    bool migrate();
+    bool seedMessageIds(); // после перезапуска id не опускаются ниже уже выданных
+    bool execute(const char* sql) const;
+    bool importLegacySessions(); // часть миграции 4
+    JoinResult joinFailureReason(int user_id, int chat_id) const;
+    bool updateMemberCount(int chat_id, int delta);
+    bool resetReadMarker(int user_id, int chat_id);
+    bool deleteReadMarker(int user_id, int chat_id);
 };
@@ -0,0 +1,186 @@
+#include "event_hub.h"
+#include <algorithm>
+
+EventHub::EventHub() : next_subscription_id(1) {}
+
+int EventHub::subscribe(int user_id, Sink sink) {
+    std::lock_guard<std::mutex> lock(hub_mutex);
+    int subscription_id = next_subscription_id++;
+    auto connection = std::make_shared<Connection>();
+    connection->sink = std::move(sink);
+    subscriptions[subscription_id] = Subscription{user_id, connection, true, {}};
+    user_subscriptions[user_id].push_back(subscription_id);
+    connected_users.insert(user_id);
+    
+    // Второе соединение того же пользователя видит тот же набор чатов;
+    // с этого момента joinChat/leaveChat для пользователя применяются
+    user_chats[user_id];
+    return subscription_id;
+}
+
+void EventHub::loadChats(int subscription_id, const std::vector<int>& chat_ids) {
+    std::lock_guard<std::mutex> lock(hub_mutex);
+    auto it = subscriptions.find(subscription_id);
+    if (it == subscriptions.end() || !it->second.loading) return; // уже отписались
+
+    // Чтение из БД могло опередить выход из чата - такие чаты пропускаем.
+    // Вход после подписки уже применил joinChat
+    Subscription& subscription = it->second;
+    for (int chat_id : chat_ids) {
+        if (subscription.left_chats.count(chat_id) == 0) addToChat(subscription.user_id, chat_id);
+    }
+    subscription.loading = false;
+    subscription.left_chats.clear();
+}
+
+void EventHub::addToChat(int user_id, int chat_id) {
+    user_chats[user_id].insert(chat_id);
+    chat_users[chat_id].insert(user_id);
+}
+
+void EventHub::unsubscribe(int subscription_id) {
+    std::unique_lock<std::mutex> lock(hub_mutex);
+    auto it = subscriptions.find(subscription_id);
+    if (it == subscriptions.end()) return;
+    std::shared_ptr<Connection> connection = it->second.connection;
+
+    auto user = user_subscriptions.find(it->second.user_id);
+    if (user != user_subscriptions.end()) {
+        auto& ids = user->second;
+        ids.erase(std::remove(ids.begin(), ids.end(), subscription_id), ids.end());
+        if (ids.empty()) {
+            // Последнее соединение пользователя: убираем его из каналов чатов
+            auto chats = user_chats.find(user->first);
+            if (chats != user_chats.end()) {
+                for (int chat_id : chats->second) {
+                    auto members = chat_users.find(chat_id);
+                    if (members == chat_users.end()) continue;
+                    members->second.erase(user->first);
+                    if (members->second.empty()) chat_users.erase(members);
+                }
+                user_chats.erase(chats);
+            }
+            connected_users.erase(user->first);
+            user_subscriptions.erase(user);
+        }
+    }
+    subscriptions.erase(it);
+    lock.unlock();
+
+    // Ждём отправку, уже начатую в это соединение; новые его не вызовут
+    std::lock_guard<std::mutex> closing(connection->mutex);
+    connection->open = false;
+    connection->sink = nullptr;
+}
+
+void EventHub::joinChat(int user_id, int chat_id) {
+    std::lock_guard<std::mutex> lock(hub_mutex);
+    auto chats = user_chats.find(user_id);
+    if (chats == user_chats.end()) return;
+    addToChat(user_id, chat_id);
+    for (int subscription_id : user_subscriptions[user_id]) {
+        Subscription& subscription = subscriptions.at(subscription_id);
+        if (subscription.loading) subscription.left_chats.erase(chat_id);
+    }
+}
+
+void EventHub::leaveChat(int user_id, int chat_id) {
+    std::lock_guard<std::mutex> lock(hub_mutex);
+    auto chats = user_chats.find(user_id);
+    if (chats == user_chats.end()) return;
+    chats->second.erase(chat_id);
+    for (int subscription_id : user_subscriptions[user_id]) {
+        Subscription& subscription = subscriptions.at(subscription_id);
+        if (subscription.loading) subscription.left_chats.insert(chat_id);
+    }
+    
+    auto members = chat_users.find(chat_id);
+    if (members != chat_users.end()) {
+        members->second.erase(user_id);
+        if (members->second.empty()) chat_users.erase(members);
+    }
+}
+
+bool EventHub::isInChat(int user_id, int chat_id) const {
+    std::lock_guard<std::mutex> lock(hub_mutex);
+    auto chats = user_chats.find(user_id);
+    return chats != user_chats.end() && chats->second.count(chat_id) > 0;
+}
+
+std::vector<int> EventHub::getUserChats(int user_id) const {
+    std::lock_guard<std::mutex> lock(hub_mutex);
+    auto chats = user_chats.find(user_id);
+    if (chats == user_chats.end()) return {};
+    return std::vector<int>(chats->second.begin(), chats->second.end());
+}
+
+MemberSet EventHub::connectedAmong(const MemberSet& user_ids) const {
+    std::lock_guard<std::mutex> lock(hub_mutex);
+    return user_ids.intersect(connected_users);
+}
+
+bool EventHub::hasSubscribers() const {
+    std::lock_guard<std::mutex> lock(hub_mutex);
+    return !subscriptions.empty();
+}
+
+bool EventHub::isConnected(int user_id) const {
+    std::lock_guard<std::mutex> lock(hub_mutex);
+    return user_subscriptions.find(user_id) != user_subscriptions.end();
+}
+
+std::size_t EventHub::sendToUsers(const std::vector<int>& user_ids, const std::string& payload) {
+    Targets targets;
+    {
+        std::lock_guard<std::mutex> lock(hub_mutex);
+        for (int user_id : user_ids) {
+            collectUser(user_id, targets);
+        }
+    }
+    return deliver(targets, payload);
+}
+
+std::size_t EventHub::sendToChat(int chat_id, const std::string& payload, int except_user_id) {
+    Targets targets;
+    {
+        std::lock_guard<std::mutex> lock(hub_mutex);
+        auto members = chat_users.find(chat_id);
+        if (members == chat_users.end()) return 0;
+        targets.reserve(members->second.size());
+        members->second.forEach([&](int user_id) {
+            if (user_id != except_user_id) collectUser(user_id, targets);
+        });
+    }
+    return deliver(targets, payload);
+}
+
+void EventHub::collectUser(int user_id, Targets& targets) const {
+    auto user = user_subscriptions.find(user_id);
+    if (user == user_subscriptions.end()) return;
+    for (int subscription_id : user->second) {
+        targets.push_back(subscriptions.at(subscription_id).connection);
+    }
+}
+
+std::size_t EventHub::deliver(const Targets& targets, const std::string& payload) {
+    if (targets.empty()) return 0;
+    Payload shared = std::make_shared<const std::string>(payload);
+    std::size_t sent = 0;
+    for (const auto& connection : targets) {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        if (!connection->open) continue; // отписались, пока собирали получателей
+        connection->sink(shared);
+        sent++;
+    }
+    events_sent += sent;
+    return sent;
+}
+
+EventHub::Metrics EventHub::getMetrics() const {
+    Metrics metrics;
+    std::lock_guard<std::mutex> lock(hub_mutex);
+    metrics.connections = subscriptions.size();
+    metrics.online_users = user_subscriptions.size();
+    metrics.events_sent = events_sent.load();
+    return metrics;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include "member_set.h"
+
+// Реестр подключённых клиентов для push-событий (чтения, набор текста, присутствие).
+// Транспорт не знает: подписчик - это функция отправки строки,
+// веб-сервер подставляет туда websocket-соединение. Одно событие - одна строка,
+// общая для всех получателей.
+// Для подключённых пользователей хранит их чаты, чтобы рассылать
+// события чата без запроса участников к БД.
+class EventHub {
+public:
+    using Payload = std::shared_ptr<const std::string>;
+    using Sink = std::function<void(const Payload&)>;
+
+    struct Metrics {
+        std::size_t connections;
+        std::size_t online_users;
+        std::uint64_t events_sent;
+    };
+
+    EventHub();
+
+    // Возвращает id подписки. Чаты пользователя догружаются после неё в loadChats:
+    // вход и выход, случившиеся между подпиской и чтением из БД, не теряются
+    int subscribe(int user_id, Sink sink);
+    // chat_ids - чаты пользователя из БД, прочитанные после subscribe
+    void loadChats(int subscription_id, const std::vector<int>& chat_ids);
+    void unsubscribe(int subscription_id);
+
+    // Изменения членства; для неподключённых пользователей ничего не делают
+    void joinChat(int user_id, int chat_id);
+    void leaveChat(int user_id, int chat_id);
+
+    bool hasSubscribers() const;
+    bool isConnected(int user_id) const;
+    bool isInChat(int user_id, int chat_id) const; // только для подключённых
+    std::vector<int> getUserChats(int user_id) const; // пусто, если не подключён
+    MemberSet connectedAmong(const MemberSet& user_ids) const; // пересечение с подключёнными
+
+    // Отправляет payload всем соединениям этих пользователей, возвращает число отправок
+    std::size_t sendToUsers(const std::vector<int>& user_ids, const std::string& payload);
+    // Всем подключённым участникам чата, кроме except_user_id
+    std::size_t sendToChat(int chat_id, const std::string& payload, int except_user_id = 0);
+
+    Metrics getMetrics() const;
+
+private:
+    // Получатели собираются под hub_mutex, а sink вызывается уже без него,
+    // под мьютексом своего соединения: медленная запись в один сокет не держит
+    // остальные рассылки и подписки. Отписка закрывает соединение под тем же мьютексом,
+    // поэтому sink никогда не вызывается для уже закрытого соединения
+    struct Connection {
+        std::mutex mutex;
+        bool open = true;
+        Sink sink;
+    };
+
+    struct Subscription {
+        int user_id;
+        std::shared_ptr<Connection> connection;
+        bool loading = true;                  // loadChats ещё не вызван
+        std::unordered_set<int> left_chats;   // вышел, пока шла загрузка: из БД не добавлять
+    };
+
+    using Targets = std::vector<std::shared_ptr<Connection>>;
+
+    mutable std::mutex hub_mutex;
+    int next_subscription_id;
+    std::unordered_map<int, Subscription> subscriptions;
+    std::unordered_map<int, std::vector<int>> user_subscriptions; // user_id -> id подписок
+    std::unordered_map<int, std::unordered_set<int>> user_chats;   // подключённые: user_id -> чаты
+    std::unordered_map<int, MemberSet> chat_users;                 // chat_id -> подключённые участники
+    MemberSet connected_users;
+
+    void collectUser(int user_id, Targets& targets) const; // под hub_mutex
+    std::size_t deliver(const Targets& targets, const std::string& payload); // без hub_mutex
+    void addToChat(int user_id, int chat_id); // под hub_mutex
+    std::atomic<std::uint64_t> events_sent{0};
+};
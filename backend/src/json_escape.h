@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+
+// Строка в JSON, собираемом вручную (события websocket): кавычки, обратный слеш
+// и управляющие символы; прочие управляющие символы отбрасываются
+inline std::string escapeJson(const std::string& text) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text) {
+        switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) >= 0x20) escaped += c;
+        }
+    }
+    return escaped;
+}
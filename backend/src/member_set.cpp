@@ -0,0 +1,267 @@
+#include "member_set.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MEMBER_SET_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// До какого размера бинарный поиск сужает диапазон перед линейным сравнением
+const std::size_t SCAN_BLOCK = 32;
+
+std::uint16_t keyOf(int id) { return static_cast<std::uint16_t>(static_cast<std::uint32_t>(id) >> 16); }
+std::uint16_t lowOf(int id) { return static_cast<std::uint16_t>(static_cast<std::uint32_t>(id) & 0xFFFF); }
+
+unsigned popcount(std::uint64_t word) {
+#ifdef _MSC_VER
+    return static_cast<unsigned>(__popcnt64(word));
+#else
+    return static_cast<unsigned>(__builtin_popcountll(word));
+#endif
+}
+
+bool testBit(const std::vector<std::uint64_t>& bits, std::uint16_t low) {
+    return (bits[low >> 6] >> (low & 63)) & 1;
+}
+
+bool arrayContains(const std::vector<std::uint16_t>& array, std::uint16_t value) {
+    const std::uint16_t* data = array.data();
+    // Первый элемент >= value лежит в [lo, hi]
+    std::size_t lo = 0, hi = array.size();
+    while (hi - lo > SCAN_BLOCK) {
+        std::size_t mid = lo + (hi - lo) / 2;
+        if (data[mid] < value) lo = mid + 1;
+        else hi = mid;
+    }
+    std::size_t end = std::min(hi + 1, array.size());
+    std::size_t i = lo;
+#ifdef MEMBER_SET_SSE2
+    // 8 значений за одно сравнение
+    __m128i needle = _mm_set1_epi16(static_cast<short>(value));
+    for (; i + 8 <= end; i += 8) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(block, needle))) return true;
+    }
+#endif
+    for (; i < end; i++) {
+        if (data[i] == value) return true;
+    }
+    return false;
+}
+
+} // namespace
+
+MemberSet::MemberSet(const std::vector<int>& ids) : cardinality(0) {
+    std::vector<int> sorted(ids);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    // Отсортированный вход раскладывается по контейнерам за один проход
+    for (int id : sorted) {
+        std::uint16_t key = keyOf(id);
+        if (containers.empty() || containers.back().key != key) {
+            containers.push_back(Container{key, 0, {}, {}});
+        }
+        Container& c = containers.back();
+        c.array.push_back(lowOf(id));
+        c.count++;
+    }
+    for (Container& c : containers) {
+        if (c.count > ARRAY_LIMIT) toBitmap(c);
+    }
+    cardinality = sorted.size();
+}
+
+bool MemberSet::insert(int id) {
+    std::uint16_t key = keyOf(id), low = lowOf(id);
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+        [](const Container& c, std::uint16_t k) { return c.key < k; });
+    if (it == containers.end() || it->key != key) {
+        it = containers.insert(it, Container{key, 0, {}, {}});
+    }
+
+    Container& c = *it;
+    if (c.isBitmap()) {
+        std::uint64_t mask = std::uint64_t(1) << (low & 63);
+        if (c.bits[low >> 6] & mask) return false;
+        c.bits[low >> 6] |= mask;
+    } else {
+        auto pos = std::lower_bound(c.array.begin(), c.array.end(), low);
+        if (pos != c.array.end() && *pos == low) return false;
+        c.array.insert(pos, low);
+    }
+    c.count++;
+    cardinality++;
+    if (!c.isBitmap() && c.count > ARRAY_LIMIT) toBitmap(c);
+    return true;
+}
+
+bool MemberSet::erase(int id) {
+    std::uint16_t key = keyOf(id), low = lowOf(id);
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+        [](const Container& c, std::uint16_t k) { return c.key < k; });
+    if (it == containers.end() || it->key != key) return false;
+
+    Container& c = *it;
+    if (c.isBitmap()) {
+        std::uint64_t mask = std::uint64_t(1) << (low & 63);
+        if (!(c.bits[low >> 6] & mask)) return false;
+        c.bits[low >> 6] &= ~mask;
+    } else {
+        auto pos = std::lower_bound(c.array.begin(), c.array.end(), low);
+        if (pos == c.array.end() || *pos != low) return false;
+        c.array.erase(pos);
+    }
+    c.count--;
+    cardinality--;
+    if (c.count == 0) {
+        containers.erase(it);
+    } else if (c.isBitmap() && c.count < BITMAP_MIN) {
+        toArray(c);
+    }
+    return true;
+}
+
+bool MemberSet::contains(int id) const {
+    const Container* c = find(keyOf(id));
+    if (!c) return false;
+    return c->isBitmap() ? testBit(c->bits, lowOf(id)) : arrayContains(c->array, lowOf(id));
+}
+
+void MemberSet::clear() {
+    containers.clear();
+    cardinality = 0;
+}
+
+MemberSet MemberSet::intersect(const MemberSet& other) const {
+    MemberSet result;
+    auto a = containers.begin(), b = other.containers.begin();
+    while (a != containers.end() && b != other.containers.end()) {
+        if (a->key < b->key) { ++a; continue; }
+        if (b->key < a->key) { ++b; continue; }
+        Container out{a->key, 0, {}, {}};
+        if (intersectContainers(*a, *b, &out) > 0) {
+            result.cardinality += out.count;
+            result.containers.push_back(std::move(out));
+        }
+        ++a;
+        ++b;
+    }
+    return result;
+}
+
+std::size_t MemberSet::intersectionSize(const MemberSet& other) const {
+    std::size_t total = 0;
+    auto a = containers.begin(), b = other.containers.begin();
+    while (a != containers.end() && b != other.containers.end()) {
+        if (a->key < b->key) { ++a; continue; }
+        if (b->key < a->key) { ++b; continue; }
+        total += intersectContainers(*a, *b, nullptr);
+        ++a;
+        ++b;
+    }
+    return total;
+}
+
+std::vector<int> MemberSet::toVector() const {
+    std::vector<int> ids;
+    ids.reserve(cardinality);
+    forEach([&ids](int id) { ids.push_back(id); });
+    return ids;
+}
+
+std::size_t MemberSet::memoryUsage() const {
+    std::size_t bytes = containers.capacity() * sizeof(Container);
+    for (const Container& c : containers) {
+        bytes += c.array.capacity() * sizeof(std::uint16_t) + c.bits.capacity() * sizeof(std::uint64_t);
+    }
+    return bytes;
+}
+
+const MemberSet::Container* MemberSet::find(std::uint16_t key) const {
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+        [](const Container& c, std::uint16_t k) { return c.key < k; });
+    return it != containers.end() && it->key == key ? &*it : nullptr;
+}
+
+// Пересечение двух контейнеров с одним ключом; out == nullptr - только подсчёт
+std::uint32_t MemberSet::intersectContainers(const Container& a, const Container& b, Container* out) {
+    std::uint32_t count = 0;
+
+    if (a.isBitmap() && b.isBitmap()) {
+        if (out) out->bits.resize(BITMAP_WORDS);
+        for (std::size_t w = 0; w < BITMAP_WORDS; w++) {
+            std::uint64_t word = a.bits[w] & b.bits[w];
+            if (out) out->bits[w] = word;
+            count += popcount(word);
+        }
+        if (out) {
+            out->count = count;
+            if (count <= ARRAY_LIMIT) toArray(*out);
+        }
+        return count;
+    }
+
+    if (a.isBitmap() || b.isBitmap()) {
+        // Массив проверяется по битовой карте
+        const Container& array = a.isBitmap() ? b : a;
+        const Container& bitmap = a.isBitmap() ? a : b;
+        for (std::uint16_t low : array.array) {
+            if (!testBit(bitmap.bits, low)) continue;
+            if (out) out->array.push_back(low);
+            count++;
+        }
+        if (out) out->count = count;
+        return count;
+    }
+
+    const Container& small = a.count <= b.count ? a : b;
+    const Container& large = a.count <= b.count ? b : a;
+    if (small.count * 16 < large.count) {
+        // Сильно разные размеры: бинарный поиск каждого значения малого массива в большом
+        auto from = large.array.begin();
+        for (std::uint16_t low : small.array) {
+            from = std::lower_bound(from, large.array.end(), low);
+            if (from == large.array.end()) break;
+            if (*from != low) continue;
+            if (out) out->array.push_back(low);
+            count++;
+        }
+    } else {
+        auto i = small.array.begin(), j = large.array.begin();
+        while (i != small.array.end() && j != large.array.end()) {
+            if (*i < *j) { ++i; continue; }
+            if (*j < *i) { ++j; continue; }
+            if (out) out->array.push_back(*i);
+            count++;
+            ++i;
+            ++j;
+        }
+    }
+    if (out) out->count = count;
+    return count;
+}
+
+void MemberSet::toBitmap(Container& c) {
+    c.bits.assign(BITMAP_WORDS, 0);
+    for (std::uint16_t low : c.array) {
+        c.bits[low >> 6] |= std::uint64_t(1) << (low & 63);
+    }
+    std::vector<std::uint16_t>().swap(c.array);
+}
+
+void MemberSet::toArray(Container& c) {
+    std::vector<std::uint16_t> array;
+    array.reserve(c.count);
+    for (std::size_t w = 0; w < BITMAP_WORDS; w++) {
+        std::uint64_t word = c.bits[w];
+        while (word) {
+            array.push_back(static_cast<std::uint16_t>(w * 64 + lowestBit(word)));
+            word &= word - 1;
+        }
+    }
+    c.array.swap(array);
+    std::vector<std::uint64_t>().swap(c.bits);
+}
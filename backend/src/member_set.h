@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Множество user_id (неотрицательных) в стиле roaring bitmap.
+// id делится на старшие 16 бит (ключ контейнера) и младшие 16 бит (значение в контейнере).
+// Контейнер до ARRAY_LIMIT значений - отсортированный массив uint16 (2 байта на участника,
+// поиск - бинарный до блока, блок сравнивается SSE2), больше - битовая карта на 65536 бит (8 КБ).
+// Так чат на 100k+ участников занимает десятки-сотни КБ, а вставка и поиск - O(log n).
+class MemberSet {
+public:
+    static const std::uint32_t ARRAY_LIMIT = 4096; // больше - выгоднее битовая карта
+    // Битовая карта обратно в массив - только ниже этого: чередование insert/erase
+    // на границе не перестраивает 8 КБ на каждом вызове
+    static const std::uint32_t BITMAP_MIN = ARRAY_LIMIT / 4 * 3;
+
+    MemberSet() : cardinality(0) {}
+    explicit MemberSet(const std::vector<int>& ids);
+
+    bool insert(int id); // false - уже было
+    bool erase(int id);  // false - не было
+    bool contains(int id) const;
+    std::size_t size() const { return cardinality; }
+    bool empty() const { return cardinality == 0; }
+    void clear();
+
+    MemberSet intersect(const MemberSet& other) const;
+    std::size_t intersectionSize(const MemberSet& other) const; // без построения результата
+
+    std::vector<int> toVector() const; // по возрастанию
+    std::size_t memoryUsage() const;   // байт под данные контейнеров
+
+    // Обход по возрастанию id
+    template <typename F>
+    void forEach(F f) const {
+        for (const Container& c : containers) {
+            int high = static_cast<int>(c.key) << 16;
+            if (!c.isBitmap()) {
+                for (std::uint16_t low : c.array) f(high | low);
+                continue;
+            }
+            for (std::size_t w = 0; w < c.bits.size(); w++) {
+                std::uint64_t word = c.bits[w];
+                while (word) {
+                    f(high | static_cast<int>(w * 64 + lowestBit(word)));
+                    word &= word - 1;
+                }
+            }
+        }
+    }
+
+private:
+    struct Container {
+        std::uint16_t key;
+        std::uint32_t count;
+        std::vector<std::uint16_t> array; // пока count <= ARRAY_LIMIT
+        std::vector<std::uint64_t> bits;  // BITMAP_WORDS слов, когда больше (до BITMAP_MIN при удалении)
+        bool isBitmap() const { return !bits.empty(); }
+    };
+
+    static const std::size_t BITMAP_WORDS = 65536 / 64;
+
+    static unsigned lowestBit(std::uint64_t word) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, word);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctzll(word));
+#endif
+    }
+
+    const Container* find(std::uint16_t key) const;
+    static std::uint32_t intersectContainers(const Container& a, const Container& b, Container* out);
+    static void toBitmap(Container& c);
+    static void toArray(Container& c);
+
+    std::vector<Container> containers; // по возрастанию key
+    std::size_t cardinality;
+};
@@ -1,12 +1,13 @@
 #include "message.h"
+#include "json_escape.h"
 #include <sstream>
-#include <iomanip>
+#include <ctime>
+#include <cstdio>
 
-Message::Message(int msg_id, int c_id, int s_id, const std::string& s_name, 
+Message::Message(std::int64_t msg_id, int c_id, int s_id, const std::string& s_name, 
                  const std::string& msg, const std::string& type)
     : message_id(msg_id), chat_id(c_id), sender_id(s_id), 
-      sender_name(s_name), content(msg), message_type(type) {
-    timestamp = getCurrentTimestamp();
+      sender_name(s_name), content(msg), timestamp(0), message_type(type) {
 }
 
 std::string Message::toJson() const {
@@ -15,19 +16,40 @@ std::string Message::toJson() const {
        << "\"message_id\":" << message_id << ","
        << "\"chat_id\":" << chat_id << ","
        << "\"sender_id\":" << sender_id << ","
-       << "\"sender_name\":\"" << sender_name << "\","
-       << "\"content\":\"" << content << "\","
-       << "\"timestamp\":\"" << timestamp << "\","
+       << "\"sender_name\":\"" << escapeJson(sender_name) << "\","
+       << "\"content\":\"" << escapeJson(content) << "\","
+       << "\"timestamp\":\"" << formatTimestamp(timestamp) << "\","
        << "\"type\":\"" << message_type << "\""
        << "}";
     return ss.str();
 }
 
-std::string Message::getCurrentTimestamp() {
-    auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
+std::int64_t Message::nowMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string Message::formatTimestamp(std::int64_t millis) {
+    std::int64_t seconds = millis / 1000 - (millis % 1000 < 0 ? 1 : 0);
     
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
-    return ss.str();
+    thread_local std::int64_t cached_second = -1;
+    thread_local std::string cached_text;
+    if (seconds == cached_second) return cached_text;
+    
+    // UTC, как прежний CURRENT_TIMESTAMP в SQLite; localtime не потокобезопасен
+    std::time_t time = static_cast<std::time_t>(seconds);
+    std::tm tm_utc{};
+#ifdef _WIN32
+    gmtime_s(&tm_utc, &time);
+#else
+    gmtime_r(&time, &tm_utc);
+#endif
+    
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d:%02d",
+                  tm_utc.tm_year + 1900, tm_utc.tm_mon + 1, tm_utc.tm_mday,
+                  tm_utc.tm_hour, tm_utc.tm_min, tm_utc.tm_sec);
+    cached_second = seconds;
+    cached_text = buffer;
+    return cached_text;
 }
\ No newline at end of file
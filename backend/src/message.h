@@ -1,22 +1,26 @@
 #pragma once
 #include <string>
 #include <chrono>
+#include <cstdint>
 
 class Message {
 public:
-    int message_id;
+    std::int64_t message_id; // SnowflakeGenerator, назначается в Database::addMessage
     int chat_id;
     int sender_id;
     std::string sender_name;
     std::string content;
-    std::string timestamp;
+    std::int64_t timestamp; // unix-время в мс (UTC); строкой - только в ответах API, см. formatTimestamp
     std::string message_type;
 
-    Message(int msg_id, int c_id, int s_id, const std::string& s_name, 
+    Message(std::int64_t msg_id, int c_id, int s_id, const std::string& s_name, 
             const std::string& msg, const std::string& type = "text");
     
     // Сериализация для отправки клиенту
     std::string toJson() const;
     
-    static std::string getCurrentTimestamp();
+    static std::int64_t nowMillis();
+    // "YYYY-MM-DD HH:MM:SS" (UTC). Строка последней секунды кэшируется в потоке,
+    // поэтому подряд идущие сообщения одной секунды не вызывают gmtime повторно.
+    static std::string formatTimestamp(std::int64_t millis);
 };
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "message_cache.h"
+#include <algorithm>
+
+MessageCache::MessageCache(std::size_t per_chat, std::size_t chats)
+    : messages_per_chat(per_chat), max_chats(chats), last_version(0) {}
+
+bool MessageCache::get(int chat_id, int count, std::vector<Message>& out) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+
+    auto it = entries.find(chat_id);
+    if (it == entries.end() || !it->second.loaded || count <= 0) {
+        return false;
+    }
+
+    Entry& entry = it->second;
+    std::size_t wanted = static_cast<std::size_t>(count);
+    if (entry.messages.size() < wanted && !entry.complete) {
+        return false; // в кэше меньше, чем просят, а в БД есть ещё
+    }
+
+    touch(entry);
+    std::size_t from = entry.messages.size() > wanted ? entry.messages.size() - wanted : 0;
+    out.assign(entry.messages.begin() + from, entry.messages.end());
+    return true;
+}
+
+std::uint64_t MessageCache::version(int chat_id) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+
+    auto it = entries.find(chat_id);
+    if (it != entries.end()) {
+        return it->second.version;
+    }
+
+    if (entries.size() >= max_chats && !lru.empty()) {
+        entries.erase(lru.back());
+        lru.pop_back();
+    }
+    lru.push_front(chat_id);
+    entries.emplace(chat_id, Entry{{}, false, false, ++last_version, lru.begin()});
+    return last_version;
+}
+
+void MessageCache::put(int chat_id, const std::vector<Message>& latest, int requested, std::uint64_t seen_version) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+
+    // Пока читали из БД, в чат написали (или запись вытеснили) - страница уже неполная
+    auto it = entries.find(chat_id);
+    if (it == entries.end() || it->second.version != seen_version) {
+        return;
+    }
+
+    Entry& entry = it->second;
+    touch(entry);
+    entry.loaded = true;
+    std::size_t from = latest.size() > messages_per_chat ? latest.size() - messages_per_chat : 0;
+    entry.messages.assign(latest.begin() + from, latest.end());
+    entry.complete = from == 0 && latest.size() < static_cast<std::size_t>(requested);
+}
+
+void MessageCache::append(const Message& message) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+
+    auto it = entries.find(message.chat_id);
+    if (it == entries.end()) {
+        return; // версию никто не снимал - сравнивать не с чем
+    }
+    it->second.version = ++last_version;
+    if (!it->second.loaded) {
+        return;
+    }
+
+    // Параллельные отправки могут прийти не по порядку id. Сообщение уже может быть
+    // в кэше: put со страницей из БД, прочитанной после коммита, успел раньше append
+    std::vector<Message>& messages = it->second.messages;
+    auto position = std::lower_bound(messages.begin(), messages.end(), message,
+        [](const Message& a, const Message& b) { return a.message_id < b.message_id; });
+    if (position != messages.end() && position->message_id == message.message_id) {
+        return;
+    }
+    messages.insert(position, message);
+
+    if (messages.size() > messages_per_chat) {
+        messages.erase(messages.begin());
+        it->second.complete = false;
+    }
+}
+
+void MessageCache::invalidate(int chat_id) {
+    std::lock_guard<std::mutex> lock(cache_mutex);
+
+    auto it = entries.find(chat_id);
+    if (it != entries.end()) {
+        lru.erase(it->second.lru_position);
+        entries.erase(it);
+    }
+}
+
+void MessageCache::touch(Entry& entry) {
+    lru.splice(lru.begin(), lru, entry.lru_position);
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include "message.h"
+
+// Кэш последних сообщений по чатам (LRU по чатам).
+// Хранит хвост истории, новые сообщения дописываются при отправке,
+// поэтому первая страница чата обычно отдаётся без запроса к БД.
+class MessageCache {
+public:
+    MessageCache(std::size_t messages_per_chat = 50, std::size_t max_chats = 1024);
+
+    // Последние count сообщений (по возрастанию id). false - промах, нужно идти в БД
+    bool get(int chat_id, int count, std::vector<Message>& out);
+
+    // Версия чата: меняется при каждом append. Снимается до чтения из БД
+    // и передаётся в put, чтобы не записать в кэш устаревшую страницу.
+    // Для чата не из кэша заводит пустую запись в LRU: версия живёт только в записи.
+    std::uint64_t version(int chat_id);
+
+    // latest - последние сообщения из БД по возрастанию id, запрошено requested штук
+    void put(int chat_id, const std::vector<Message>& latest, int requested, std::uint64_t seen_version);
+    void append(const Message& message);
+    void invalidate(int chat_id);
+
+    std::size_t getCapacity() const { return messages_per_chat; }
+
+private:
+    struct Entry {
+        std::vector<Message> messages;
+        bool complete;  // в чате нет сообщений старше закэшированных
+        bool loaded;    // false - версия снята, страница из БД ещё не положена
+        std::uint64_t version;
+        std::list<int>::iterator lru_position;
+    };
+
+    void touch(Entry& entry);
+
+    std::size_t messages_per_chat;
+    std::size_t max_chats;
+    std::unordered_map<int, Entry> entries;
+    // Версии берутся из общего счётчика: запись, вытесненная и созданная заново,
+    // не повторит версию, снятую до вытеснения
+    std::uint64_t last_version;
+    std::list<int> lru; // спереди - недавно использованные
+    std::mutex cache_mutex;
+};
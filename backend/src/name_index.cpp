@@ -0,0 +1,91 @@
+#include "name_index.h"
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+
+void NameIndex::add(int id, const std::string& name) {
+    std::unique_lock<std::shared_mutex> lock(index_mutex);
+    if (!names.emplace(id, name).second) return;
+
+    Entry entry{fold(name), id};
+    recent.insert(std::upper_bound(recent.begin(), recent.end(), entry), std::move(entry));
+
+    if (recent.size() >= MERGE_THRESHOLD) {
+        std::vector<Entry> merged;
+        merged.reserve(sorted.size() + recent.size());
+        std::merge(std::make_move_iterator(sorted.begin()), std::make_move_iterator(sorted.end()),
+                   std::make_move_iterator(recent.begin()), std::make_move_iterator(recent.end()),
+                   std::back_inserter(merged));
+        sorted.swap(merged);
+        recent.clear();
+    }
+}
+
+std::vector<NameIndex::Match> NameIndex::find(const std::string& prefix, int after_id, std::size_t limit) const {
+    std::vector<Match> matches;
+    std::string key = fold(prefix);
+
+    std::shared_lock<std::shared_mutex> lock(index_mutex);
+    // Начало страницы: сразу после (ключ, id) последнего результата или первый ключ с префиксом
+    Entry start{key, 0};
+    bool exclusive = false;
+    if (after_id > 0) {
+        auto last = names.find(after_id);
+        if (last != names.end()) {
+            start = Entry{fold(last->second), after_id};
+            exclusive = true;
+        }
+    }
+    auto from = [&](const std::vector<Entry>& entries) {
+        return exclusive ? std::upper_bound(entries.begin(), entries.end(), start)
+                         : std::lower_bound(entries.begin(), entries.end(), start);
+    };
+    auto a = from(sorted), b = from(recent);
+
+    // Слияние двух упорядоченных массивов, пока ключ начинается с префикса
+    auto hasPrefix = [&key](const Entry& entry) { return entry.key.compare(0, key.size(), key) == 0; };
+    while (matches.size() < limit) {
+        bool a_ok = a != sorted.end() && hasPrefix(*a);
+        bool b_ok = b != recent.end() && hasPrefix(*b);
+        if (!a_ok && !b_ok) break;
+
+        const Entry& next = (a_ok && (!b_ok || *a < *b)) ? *a++ : *b++;
+        matches.push_back(Match{next.id, names.at(next.id)});
+    }
+    return matches;
+}
+
+std::size_t NameIndex::size() const {
+    std::shared_lock<std::shared_mutex> lock(index_mutex);
+    return names.size();
+}
+
+std::string NameIndex::fold(const std::string& name) {
+    std::string folded;
+    folded.reserve(name.size());
+    for (std::size_t i = 0; i < name.size(); i++) {
+        unsigned char c = static_cast<unsigned char>(name[i]);
+        if (c >= 'A' && c <= 'Z') {
+            folded += static_cast<char>(c + ('a' - 'A'));
+        } else if (c == 0xD0 && i + 1 < name.size()) {
+            // Заглавные кириллицы в UTF-8: D0 90..AF (А..Я) и D0 81 (Ё)
+            unsigned char next = static_cast<unsigned char>(name[++i]);
+            if (next >= 0x90 && next <= 0x9F) {         // А..П -> D0 B0..BF
+                folded += static_cast<char>(0xD0);
+                folded += static_cast<char>(next + 0x20);
+            } else if (next >= 0xA0 && next <= 0xAF) {  // Р..Я -> D1 80..8F
+                folded += static_cast<char>(0xD1);
+                folded += static_cast<char>(next - 0x20);
+            } else if (next == 0x81) {                  // Ё -> D1 91
+                folded += static_cast<char>(0xD1);
+                folded += static_cast<char>(0x91);
+            } else {
+                folded += static_cast<char>(c);
+                folded += static_cast<char>(next);
+            }
+        } else {
+            folded += static_cast<char>(c);
+        }
+    }
+    return folded;
+}
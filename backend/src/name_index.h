@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <shared_mutex>
+
+// Префиксный индекс имён (пользователи, чаты) для подсказок при вводе.
+// Ключ - имя в нижнем регистре (ASCII и кириллица), записи упорядочены по (ключ, id):
+// поиск - бинарный до первого ключа с префиксом, дальше подряд до limit.
+// Новые имена попадают в небольшой отсортированный массив recent и сливаются
+// с основным, когда он дорастает до MERGE_THRESHOLD, - вставка не сдвигает весь индекс.
+class NameIndex {
+public:
+    struct Match {
+        int id;
+        std::string name;
+    };
+
+    NameIndex() = default;
+    NameIndex(const NameIndex&) = delete;
+    NameIndex& operator=(const NameIndex&) = delete;
+
+    void add(int id, const std::string& name); // id уже в индексе - ничего не делает
+    // Имена с префиксом по возрастанию; after_id - последний id предыдущей страницы (0 - с начала)
+    std::vector<Match> find(const std::string& prefix, int after_id, std::size_t limit) const;
+    std::size_t size() const;
+
+    static std::string fold(const std::string& name); // нижний регистр для ASCII и кириллицы
+
+private:
+    struct Entry {
+        std::string key;
+        int id;
+        bool operator<(const Entry& other) const {
+            return key < other.key || (key == other.key && id < other.id);
+        }
+    };
+
+    static const std::size_t MERGE_THRESHOLD = 4096;
+
+    std::vector<Entry> sorted;
+    std::vector<Entry> recent;
+    std::unordered_map<int, std::string> names; // id -> имя как есть
+    mutable std::shared_mutex index_mutex;
+};
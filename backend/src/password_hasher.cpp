@@ -0,0 +1,134 @@
+#include "password_hasher.h"
+#include "token_generator.h"
+#include "../../Crow/include/crow/TinySHA1.hpp"
+#include <algorithm>
+
+namespace {
+const std::size_t BLOCK_SIZE = 64;
+const std::size_t DIGEST_SIZE = 20;
+const std::size_t SALT_SIZE = 16;
+const char* const PREFIX = "pbkdf2-sha1$";
+const std::size_t PREFIX_LENGTH = 12;
+const int MAX_ITERATIONS = 10000000;
+
+bool fromHex(const std::string& text, unsigned char* out, std::size_t size) {
+    if (text.size() != size * 2) return false;
+    for (std::size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        int value;
+        if (c >= '0' && c <= '9') value = c - '0';
+        else if (c >= 'a' && c <= 'f') value = c - 'a' + 10;
+        else return false;
+        if (i % 2 == 0) out[i / 2] = static_cast<unsigned char>(value << 4);
+        else out[i / 2] |= static_cast<unsigned char>(value);
+    }
+    return true;
+}
+
+// Сравнение без раннего выхода
+bool sameBytes(const unsigned char* a, const unsigned char* b, std::size_t size) {
+    unsigned char diff = 0;
+    for (std::size_t i = 0; i < size; i++) diff |= a[i] ^ b[i];
+    return diff == 0;
+}
+
+// PBKDF2-HMAC-SHA1 с одним блоком вывода (dkLen = 20).
+// Состояния SHA1 после ipad/opad считаются один раз и копируются на каждую итерацию.
+void pbkdf2(const std::string& password, const unsigned char* salt, std::size_t salt_size,
+            int iterations, unsigned char* out) {
+    unsigned char key[BLOCK_SIZE] = {0};
+    if (password.size() > BLOCK_SIZE) {
+        sha1::SHA1 hash;
+        hash.processBytes(password.data(), password.size());
+        hash.getDigestBytes(key);
+    } else {
+        std::copy(password.begin(), password.end(), key);
+    }
+
+    sha1::SHA1 inner_base;
+    sha1::SHA1 outer_base;
+    unsigned char pad[BLOCK_SIZE];
+    for (std::size_t i = 0; i < BLOCK_SIZE; i++) pad[i] = key[i] ^ 0x36;
+    inner_base.processBytes(pad, BLOCK_SIZE);
+    for (std::size_t i = 0; i < BLOCK_SIZE; i++) pad[i] = key[i] ^ 0x5c;
+    outer_base.processBytes(pad, BLOCK_SIZE);
+
+    auto hmac = [&](const unsigned char* data, std::size_t size, const unsigned char* tail,
+                    std::size_t tail_size, unsigned char* digest) {
+        sha1::SHA1 inner = inner_base;
+        inner.processBytes(data, size);
+        if (tail_size > 0) inner.processBytes(tail, tail_size);
+        inner.getDigestBytes(digest);
+
+        sha1::SHA1 outer = outer_base;
+        outer.processBytes(digest, DIGEST_SIZE);
+        outer.getDigestBytes(digest);
+    };
+
+    const unsigned char block_index[4] = {0, 0, 0, 1};
+    unsigned char u[DIGEST_SIZE];
+    hmac(salt, salt_size, block_index, sizeof(block_index), u);
+    std::copy(u, u + DIGEST_SIZE, out);
+    for (int i = 1; i < iterations; i++) {
+        hmac(u, DIGEST_SIZE, nullptr, 0, u);
+        for (std::size_t j = 0; j < DIGEST_SIZE; j++) out[j] ^= u[j];
+    }
+}
+}
+
+std::string PasswordHasher::hash(const std::string& password, int iterations) {
+    unsigned char salt[SALT_SIZE];
+    TokenGenerator::fill(salt, SALT_SIZE);
+
+    unsigned char derived[DIGEST_SIZE];
+    pbkdf2(password, salt, SALT_SIZE, iterations, derived);
+    return PREFIX + std::to_string(iterations) + "$" + TokenGenerator::toHex(salt, SALT_SIZE) + "$" +
+           TokenGenerator::toHex(derived, DIGEST_SIZE);
+}
+
+bool PasswordHasher::isHashed(const std::string& stored) {
+    return stored.compare(0, PREFIX_LENGTH, PREFIX) == 0;
+}
+
+bool PasswordHasher::verify(const std::string& password, const std::string& stored, bool& needs_rehash) {
+    needs_rehash = false;
+
+    if (!isHashed(stored)) {
+        // Пароль, сохранённый до хеширования: сравниваем как есть и просим перехешировать
+        std::size_t size = std::max(password.size(), stored.size());
+        unsigned char diff = password.size() == stored.size() ? 0 : 1;
+        for (std::size_t i = 0; i < size; i++) {
+            unsigned char a = i < password.size() ? password[i] : 0;
+            unsigned char b = i < stored.size() ? stored[i] : 0;
+            diff |= a ^ b;
+        }
+        needs_rehash = (diff == 0);
+        return diff == 0;
+    }
+
+    std::size_t first = stored.find('$', PREFIX_LENGTH);
+    std::size_t second = first == std::string::npos ? first : stored.find('$', first + 1);
+    if (second == std::string::npos) return false;
+
+    std::string iterations_text = stored.substr(PREFIX_LENGTH, first - PREFIX_LENGTH);
+    if (iterations_text.empty() || iterations_text.size() > 8 ||
+        iterations_text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    int iterations = std::stoi(iterations_text);
+
+    unsigned char salt[SALT_SIZE];
+    unsigned char expected[DIGEST_SIZE];
+    if (iterations <= 0 || iterations > MAX_ITERATIONS ||
+        !fromHex(stored.substr(first + 1, second - first - 1), salt, SALT_SIZE) ||
+        !fromHex(stored.substr(second + 1), expected, DIGEST_SIZE)) {
+        return false;
+    }
+
+    unsigned char derived[DIGEST_SIZE];
+    pbkdf2(password, salt, SALT_SIZE, iterations, derived);
+    if (!sameBytes(derived, expected, DIGEST_SIZE)) return false;
+
+    needs_rehash = iterations < DEFAULT_ITERATIONS;
+    return true;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <string>
+
+// Хеши паролей: pbkdf2-sha1$<итерации>$<соль>$<хеш> (PBKDF2-HMAC-SHA1, соль и хеш в hex).
+// Намеренно медленно (десятки мс на вызов) - вызывать с пула auth_executor, не из I/O потоков Crow.
+class PasswordHasher {
+public:
+    static const int DEFAULT_ITERATIONS = 60000;
+
+    static std::string hash(const std::string& password, int iterations = DEFAULT_ITERATIONS);
+    // needs_rehash = true, если пароль верный, но хранится открытым текстом
+    // (записи до хеширования) или с меньшим числом итераций
+    static bool verify(const std::string& password, const std::string& stored, bool& needs_rehash);
+    static bool isHashed(const std::string& stored);
+};
@@ -0,0 +1,151 @@
+#include "presence.h"
+
+PresenceTable::PresenceTable(TimerWheel& wheel, std::chrono::seconds idle)
+    : timers(wheel), started(std::chrono::steady_clock::now()),
+      idle_after(static_cast<std::uint32_t>(idle.count() > 0 ? idle.count() : 1)) {
+    for (auto& chunk : chunks) {
+        chunk.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+PresenceTable::~PresenceTable() {
+    for (auto& chunk : chunks) {
+        delete[] chunk.load();
+    }
+}
+
+PresenceTable::Slot* PresenceTable::find(int user_id) const {
+    if (user_id <= 0) return nullptr;
+    std::size_t index = static_cast<std::size_t>(user_id);
+    std::size_t chunk = index / CHUNK_SIZE;
+    if (chunk >= MAX_CHUNKS) return nullptr;
+
+    Slot* slots = chunks[chunk].load(std::memory_order_acquire);
+    return slots ? &slots[index % CHUNK_SIZE] : nullptr;
+}
+
+PresenceTable::Slot* PresenceTable::findOrCreate(int user_id) {
+    if (user_id <= 0) return nullptr;
+    std::size_t index = static_cast<std::size_t>(user_id);
+    std::size_t chunk = index / CHUNK_SIZE;
+    if (chunk >= MAX_CHUNKS) return nullptr;
+
+    Slot* slots = chunks[chunk].load(std::memory_order_acquire);
+    if (!slots) {
+        // Гонку за выделение блока решает CAS, проигравший освобождает свой
+        Slot* fresh = new Slot[CHUNK_SIZE];
+        if (chunks[chunk].compare_exchange_strong(slots, fresh, std::memory_order_acq_rel)) {
+            slots = fresh;
+        } else {
+            delete[] fresh;
+        }
+    }
+    return &slots[index % CHUNK_SIZE];
+}
+
+std::uint32_t PresenceTable::now() const {
+    auto elapsed = std::chrono::steady_clock::now() - started;
+    return static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(elapsed).count());
+}
+
+void PresenceTable::markChanged(int user_id, Slot& slot) {
+    if (slot.queued.exchange(true)) return; // уже ждёт рассылки
+    std::lock_guard<std::mutex> lock(changed_mutex);
+    changed.push_back(user_id);
+}
+
+void PresenceTable::armIdleTimer(int user_id, std::chrono::seconds delay) {
+    timers.schedule(delay, [this, user_id]() { checkIdle(user_id); });
+}
+
+void PresenceTable::checkIdle(int user_id) {
+    Slot* slot = find(user_id);
+    if (!slot) return;
+
+    // Сначала снимаем флаг, потом проверяем подключения: connect, увидевший
+    // снятый флаг, запустит новую цепочку, иначе её продолжим мы
+    slot->timer_armed.store(false);
+    if (slot->connections.load() == 0 || slot->timer_armed.exchange(true)) return;
+
+    std::uint32_t inactive = now() - slot->last_active.load(std::memory_order_relaxed);
+    if (inactive < idle_after) {
+        armIdleTimer(user_id, std::chrono::seconds(idle_after - inactive));
+        return;
+    }
+    if (!slot->idle.exchange(true)) {
+        markChanged(user_id, *slot);
+    }
+    armIdleTimer(user_id, std::chrono::seconds(idle_after));
+}
+
+void PresenceTable::connect(int user_id) {
+    Slot* slot = findOrCreate(user_id);
+    if (!slot) return;
+    slot->last_active.store(now(), std::memory_order_relaxed);
+    // Новое подключение простаивавшего тоже меняет статус (idle -> online)
+    bool was_idle = slot->idle.exchange(false);
+    if (slot->connections.fetch_add(1) == 0 || was_idle) {
+        markChanged(user_id, *slot);
+    }
+    if (!slot->timer_armed.exchange(true)) {
+        armIdleTimer(user_id, std::chrono::seconds(idle_after));
+    }
+}
+
+void PresenceTable::disconnect(int user_id) {
+    Slot* slot = find(user_id);
+    if (!slot) return;
+    std::uint32_t connections = slot->connections.load();
+    while (connections > 0 && !slot->connections.compare_exchange_weak(connections, connections - 1)) {}
+    if (connections == 1) {
+        markChanged(user_id, *slot);
+    }
+}
+
+void PresenceTable::touch(int user_id) {
+    Slot* slot = find(user_id); // без подключения активность не важна
+    if (!slot) return;
+    slot->last_active.store(now(), std::memory_order_relaxed);
+    if (slot->idle.load(std::memory_order_relaxed) && slot->idle.exchange(false)) {
+        markChanged(user_id, *slot);
+    }
+}
+
+PresenceTable::Status PresenceTable::statusOf(const Slot& slot) const {
+    if (slot.connections.load() == 0) return OFFLINE;
+    return slot.idle.load() ? IDLE : ONLINE;
+}
+
+PresenceTable::Status PresenceTable::getStatus(int user_id) const {
+    Slot* slot = find(user_id);
+    return slot ? statusOf(*slot) : OFFLINE;
+}
+
+const char* PresenceTable::statusName(Status status) {
+    switch (status) {
+        case ONLINE: return "online";
+        case IDLE: return "idle";
+        default: return "offline";
+    }
+}
+
+std::vector<PresenceTable::Delta> PresenceTable::collectDeltas() {
+    std::vector<int> users;
+    {
+        std::lock_guard<std::mutex> lock(changed_mutex);
+        users.swap(changed);
+    }
+
+    // Промежуточные переходы за интервал схлопываются: сравниваем только
+    // текущее состояние с последним разосланным
+    std::vector<Delta> deltas;
+    for (int user_id : users) {
+        Slot* slot = find(user_id);
+        slot->queued.store(false);
+        Status status = statusOf(*slot);
+        if (status == slot->published.load(std::memory_order_relaxed)) continue;
+        slot->published.store(status, std::memory_order_relaxed);
+        deltas.push_back(Delta{user_id, status});
+    }
+    return deltas;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include "timer_wheel.h"
+
+// Присутствие пользователей (online/idle/offline) без блокировок.
+// Таблица индексируется user_id: блоки по CHUNK_SIZE слотов выделяются при первом
+// обращении и живут до конца работы, поэтому чтение и запись - атомарные операции над слотом.
+// online - есть подключение и активность не старше idle_after, idle - подключение без активности.
+// Переход в idle проверяет таймер в общем колесе (один на подключённого пользователя),
+// изменившиеся пользователи попадают в очередь для collectDeltas.
+class PresenceTable {
+public:
+    enum Status : std::uint8_t { OFFLINE = 0, ONLINE = 1, IDLE = 2 };
+
+    struct Delta {
+        int user_id;
+        Status status;
+    };
+
+    explicit PresenceTable(TimerWheel& timers, std::chrono::seconds idle_after = std::chrono::seconds(300));
+    ~PresenceTable();
+
+    PresenceTable(const PresenceTable&) = delete;
+    PresenceTable& operator=(const PresenceTable&) = delete;
+
+    void connect(int user_id);
+    void disconnect(int user_id);
+    void touch(int user_id); // активность пользователя (запрос, событие от клиента)
+
+    Status getStatus(int user_id) const;
+    static const char* statusName(Status status);
+
+    // Изменения с прошлого вызова: не больше одной записи на пользователя,
+    // промежуточные переходы схлопываются. Вызывается из одного потока.
+    std::vector<Delta> collectDeltas();
+
+private:
+    struct Slot {
+        std::atomic<std::uint32_t> connections{0};
+        std::atomic<std::uint32_t> last_active{0};        // секунды от запуска
+        std::atomic<bool> idle{false};
+        std::atomic<bool> timer_armed{false};             // идёт цепочка проверок простоя
+        std::atomic<bool> queued{false};                  // уже в очереди изменений
+        std::atomic<std::uint8_t> published{OFFLINE};     // последний разосланный статус
+    };
+
+    static const std::size_t CHUNK_SIZE = 1024;
+    static const std::size_t MAX_CHUNKS = 4096; // до ~4 млн пользователей
+
+    Slot* find(int user_id) const;
+    Slot* findOrCreate(int user_id);
+    std::uint32_t now() const;
+    Status statusOf(const Slot& slot) const;
+    void markChanged(int user_id, Slot& slot);
+    void armIdleTimer(int user_id, std::chrono::seconds delay);
+    void checkIdle(int user_id);
+
+    TimerWheel& timers;
+    std::atomic<Slot*> chunks[MAX_CHUNKS];
+    const std::chrono::steady_clock::time_point started;
+    const std::uint32_t idle_after;
+
+    std::mutex changed_mutex; // только очередь изменений, не слоты
+    std::vector<int> changed;
+};
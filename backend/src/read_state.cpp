@@ -0,0 +1,335 @@
+#include "read_state.h"
+#include <iostream>
+
+const std::chrono::seconds ReadStateTracker::IDLE_TIMEOUT(60);
+
+ReadStateTracker::ReadStateTracker(Database& db, std::chrono::milliseconds flush_interval)
+    : database(db), interval(flush_interval), stopping(false) {
+    flusher = std::thread([this]() { flushLoop(); });
+}
+
+ReadStateTracker::~ReadStateTracker() {
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex);
+        stopping = true;
+    }
+    stop_cv.notify_all();
+    if (flusher.joinable()) flusher.join();
+    flush();
+}
+
+ReadStateTracker::State ReadStateTracker::getState(int user_id, int chat_id) {
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        auto chat = chats.find(chat_id);
+        if (chat != chats.end()) {
+            auto it = chat->second.users.find(user_id);
+            if (it != chat->second.users.end()) {
+                touch(chat->second);
+                return it->second.state;
+            }
+        }
+    }
+    return load(user_id, chat_id);
+}
+
+std::unordered_map<int, ReadStateTracker::State> ReadStateTracker::getStates(int user_id, const std::vector<int>& chat_ids) {
+    std::unordered_map<int, State> result;
+    std::unordered_map<int, std::uint64_t> missing; // chat_id -> версия до запроса
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        for (int chat_id : chat_ids) {
+            auto chat = chats.find(chat_id);
+            if (chat != chats.end()) {
+                auto it = chat->second.users.find(user_id);
+                if (it != chat->second.users.end()) {
+                    touch(chat->second);
+                    result[chat_id] = it->second.state;
+                    continue;
+                }
+            }
+            missing[chat_id] = versionOf(chat_id);
+        }
+    }
+    if (missing.empty()) return result;
+
+    auto markers = database.getReadMarkers(user_id);
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        for (const auto& marker : markers) {
+            auto seen = missing.find(marker.chat_id);
+            if (seen == missing.end()) continue;
+
+            if (versionOf(marker.chat_id) != seen->second) continue;
+            ChatState& chat = chatState(marker.chat_id);
+            auto it = chat.users.find(user_id);
+            if (it != chat.users.end()) {
+                result[marker.chat_id] = it->second.state; // успели загрузить параллельно
+            } else {
+                State state{marker.last_read_message_id, marker.unread_count};
+                chat.users[user_id] = Entry{state, false, false};
+                result[marker.chat_id] = state;
+            }
+        }
+    }
+
+    // Пока считали, в чат написали (или отметки нет) - догружаем по одному
+    for (const auto& entry : missing) {
+        if (result.find(entry.first) == result.end()) {
+            result[entry.first] = load(user_id, entry.first);
+        }
+    }
+    return result;
+}
+
+ReadStateTracker::State ReadStateTracker::load(int user_id, int chat_id) {
+    // Счёт из БД верен, только если за время запроса в чат не пришло сообщений:
+    // иначе новое сообщение может учесться дважды (в COUNT и в onMessage)
+    for (int attempt = 0; ; attempt++) {
+        std::uint64_t version;
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            auto chat = chats.find(chat_id);
+            if (chat != chats.end()) {
+                auto it = chat->second.users.find(user_id);
+                if (it != chat->second.users.end()) return it->second.state;
+            }
+            version = versionOf(chat_id);
+        }
+
+        std::int64_t last_read = database.getReadMarker(user_id, chat_id);
+        int unread = database.countMessagesAfter(chat_id, last_read);
+
+        std::lock_guard<std::mutex> lock(state_mutex);
+        bool unchanged = versionOf(chat_id) == version;
+        ChatState& chat = chatState(chat_id);
+        auto it = chat.users.find(user_id);
+        if (it != chat.users.end()) return it->second.state;
+        if (unchanged || attempt + 1 >= LOAD_ATTEMPTS) {
+            State state{last_read, unread};
+            chat.users[user_id] = Entry{state, false, false};
+            return state;
+        }
+    }
+}
+
+void ReadStateTracker::onMessage(int chat_id, int sender_id, std::int64_t message_id) {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    ChatState& chat = chatState(chat_id);
+    chat.version = ++last_version;
+    if (chat.last_message_id >= 0 && message_id > chat.last_message_id) {
+        chat.last_message_id = message_id;
+    }
+
+    for (auto& user : chat.users) {
+        State& state = user.second.state;
+        if (message_id <= state.last_read_message_id) continue;
+        if (user.first == sender_id) continue;
+        state.unread_count++;
+    }
+
+    // Отправитель прочитал чат до своего сообщения
+    Entry& sender = chat.users[sender_id];
+    if (message_id > sender.state.last_read_message_id) {
+        sender.state = State{message_id, 0};
+        setDirty(chat_id, sender_id, chat, sender);
+    }
+}
+
+std::int64_t ReadStateTracker::getLastMessageId(int chat_id) {
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        auto chat = chats.find(chat_id);
+        if (chat != chats.end() && chat->second.last_message_id >= 0) return chat->second.last_message_id;
+    }
+    
+    // Запоминается в markRead вместе с парой: чат без пар в памяти не держится
+    return database.getLastMessageId(chat_id);
+}
+
+bool ReadStateTracker::markRead(int user_id, int chat_id, std::int64_t message_id, State& state) {
+    std::int64_t last_message_id = getLastMessageId(chat_id);
+    if (message_id <= 0 || message_id > last_message_id) {
+        message_id = last_message_id;
+    }
+    
+    state = getState(user_id, chat_id);
+    for (int attempt = 0; ; attempt++) {
+        std::uint64_t version;
+        {
+            std::lock_guard<std::mutex> lock(state_mutex);
+            // Пару удалил forget - пользователь вышел; заново её не загружаем
+            auto chat = chats.find(chat_id);
+            if (chat == chats.end()) return false;
+            auto it = chat->second.users.find(user_id);
+            if (it == chat->second.users.end()) return false;
+            
+            touch(chat->second);
+            state = it->second.state;
+            if (message_id <= state.last_read_message_id) return true;
+            if (last_message_id > chat->second.last_message_id) {
+                chat->second.last_message_id = last_message_id;
+            }
+            
+            // Прочитано до конца - считать нечего (обычный случай при прокрутке вниз)
+            if (message_id >= chat->second.last_message_id) {
+                it->second.state = State{message_id, 0};
+                setDirty(chat_id, user_id, chat->second, it->second);
+                setReceiptPending(chat_id, user_id, chat->second, it->second);
+                state = it->second.state;
+                return true;
+            }
+            version = chat->second.version;
+        }
+
+        int unread = database.countMessagesAfter(chat_id, message_id);
+
+        std::lock_guard<std::mutex> lock(state_mutex);
+        auto chat = chats.find(chat_id);
+        if (chat == chats.end()) return false;
+        auto it = chat->second.users.find(user_id);
+        if (it == chat->second.users.end()) return false;
+        if (message_id <= it->second.state.last_read_message_id) {
+            state = it->second.state;
+            return true;
+        }
+        if (chat->second.version == version || attempt + 1 >= LOAD_ATTEMPTS) {
+            it->second.state = State{message_id, unread};
+            setDirty(chat_id, user_id, chat->second, it->second);
+            setReceiptPending(chat_id, user_id, chat->second, it->second);
+            state = it->second.state;
+            return true;
+        }
+    }
+}
+
+void ReadStateTracker::forget(int user_id, int chat_id) {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    auto chat = chats.find(chat_id);
+    if (chat == chats.end()) return;
+    auto it = chat->second.users.find(user_id);
+    if (it == chat->second.users.end()) return;
+    // Несохранённая отметка вышедшего не нужна; записи в очередях flush и takeReceipts пропустят
+    if (it->second.dirty) chat->second.dirty_count--;
+    if (it->second.receipt_pending) chat->second.pending_count--;
+    chat->second.users.erase(it);
+    if (chat->second.users.empty()) eraseChat(chat);
+}
+
+ReadStateTracker::ChatState& ReadStateTracker::chatState(int chat_id) {
+    auto inserted = chats.emplace(chat_id, ChatState());
+    ChatState& chat = inserted.first->second;
+    if (inserted.second) {
+        chat.version = ++last_version;
+        lru.push_front(chat_id);
+        chat.lru_position = lru.begin();
+    }
+    touch(chat);
+    return chat;
+}
+
+std::uint64_t ReadStateTracker::versionOf(int chat_id) const {
+    auto chat = chats.find(chat_id);
+    return chat != chats.end() ? chat->second.version : removed_version;
+}
+
+void ReadStateTracker::touch(ChatState& chat) {
+    chat.last_used = std::chrono::steady_clock::now();
+    lru.splice(lru.begin(), lru, chat.lru_position);
+}
+
+void ReadStateTracker::setDirty(int chat_id, int user_id, ChatState& chat, Entry& entry) {
+    if (entry.dirty) return; // пара уже в очереди
+    entry.dirty = true;
+    chat.dirty_count++;
+    dirty_queue.emplace_back(chat_id, user_id);
+}
+
+void ReadStateTracker::setReceiptPending(int chat_id, int user_id, ChatState& chat, Entry& entry) {
+    if (entry.receipt_pending) return; // пара уже в очереди
+    entry.receipt_pending = true;
+    chat.pending_count++;
+    receipt_queue.emplace_back(chat_id, user_id);
+}
+
+void ReadStateTracker::eraseChat(std::unordered_map<int, ChatState>::iterator chat) {
+    lru.erase(chat->second.lru_position);
+    chats.erase(chat);
+    removed_version = ++last_version;
+}
+
+void ReadStateTracker::evictIdle() {
+    auto now = std::chrono::steady_clock::now();
+    while (!lru.empty()) {
+        auto chat = chats.find(lru.back());
+        if (now - chat->second.last_used < IDLE_TIMEOUT) break;
+        if (chat->second.dirty_count > 0 || chat->second.pending_count > 0) {
+            touch(chat->second); // дождётся следующего flush или рассылки
+            continue;
+        }
+        // Счётчики восстановятся из БД при следующем обращении (load)
+        eraseChat(chat);
+    }
+}
+
+std::vector<ReadMarker> ReadStateTracker::takeReceipts() {
+    std::vector<ReadMarker> receipts;
+    std::vector<std::pair<int, int>> pairs;
+    std::lock_guard<std::mutex> lock(state_mutex);
+    pairs.swap(receipt_queue);
+    for (const auto& pair : pairs) {
+        auto chat = chats.find(pair.first);
+        if (chat == chats.end()) continue;
+        auto it = chat->second.users.find(pair.second);
+        if (it == chat->second.users.end() || !it->second.receipt_pending) continue; // вышел из чата
+        receipts.push_back({pair.second, pair.first, it->second.state.last_read_message_id, it->second.state.unread_count});
+        it->second.receipt_pending = false;
+        chat->second.pending_count--;
+    }
+    return receipts;
+}
+
+bool ReadStateTracker::flush() {
+    std::vector<ReadMarker> markers;
+    {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        std::vector<std::pair<int, int>> pairs;
+        pairs.swap(dirty_queue);
+        for (const auto& pair : pairs) {
+            auto chat = chats.find(pair.first);
+            if (chat == chats.end()) continue;
+            auto it = chat->second.users.find(pair.second);
+            if (it == chat->second.users.end() || !it->second.dirty) continue;
+            markers.push_back({pair.second, pair.first, it->second.state.last_read_message_id, it->second.state.unread_count});
+            it->second.dirty = false;
+            chat->second.dirty_count--;
+        }
+    }
+
+    if (!markers.empty() && !database.saveReadMarkers(markers)) {
+        std::cerr << "ERROR: failed to save " << markers.size() << " read markers, will retry" << std::endl;
+        std::lock_guard<std::mutex> lock(state_mutex);
+        for (const auto& marker : markers) {
+            auto chat = chats.find(marker.chat_id);
+            if (chat == chats.end()) continue;
+            auto it = chat->second.users.find(marker.user_id);
+            if (it != chat->second.users.end()) setDirty(marker.chat_id, marker.user_id, chat->second, it->second);
+        }
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(state_mutex);
+    evictIdle();
+    return true;
+}
+
+void ReadStateTracker::flushLoop() {
+    std::unique_lock<std::mutex> lock(stop_mutex);
+    while (!stopping) {
+        stop_cv.wait_for(lock, interval, [this]() { return stopping; });
+        if (stopping) break;
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+#include <list>
+#include <utility>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include "database.h"
+
+// Непрочитанные по парам (пользователь, чат) в памяти.
+// Пара загружается из БД при первом обращении, дальше счётчик меняется
+// на отправке (+1 остальным загруженным участникам) и на прочтении.
+// Изменённые отметки пачкой пишутся в БД фоновым потоком (только пары из очереди),
+// а явные прочтения копятся для рассылки (takeReceipts) - по одной на пару.
+// Чат без несохранённых изменений, не тронутый IDLE_TIMEOUT, выгружается при flush.
+// Членство трекер не проверяет: это делает вызывающий код по БД.
+class ReadStateTracker {
+public:
+    struct State {
+        std::int64_t last_read_message_id;
+        int unread_count;
+    };
+
+    ReadStateTracker(Database& database, std::chrono::milliseconds flush_interval = std::chrono::milliseconds(2000));
+    ~ReadStateTracker(); // останавливает поток и сбрасывает остаток в БД
+
+    ReadStateTracker(const ReadStateTracker&) = delete;
+    ReadStateTracker& operator=(const ReadStateTracker&) = delete;
+
+    State getState(int user_id, int chat_id);
+    // Для списка чатов: недостающие пары грузятся одним запросом
+    std::unordered_map<int, State> getStates(int user_id, const std::vector<int>& chat_ids);
+
+    // Сообщение уже сохранено в БД
+    void onMessage(int chat_id, int sender_id, std::int64_t message_id);
+    // message_id <= 0 или дальше последнего сообщения - до последнего сообщения.
+    // false - пару удалили (forget) во время отметки: пользователь вышел из чата
+    bool markRead(int user_id, int chat_id, std::int64_t message_id, State& state);
+    void forget(int user_id, int chat_id); // пользователь вышел из чата
+
+    // Накопленные с прошлого вызова прочтения, по одному (максимальному) на пару
+    std::vector<ReadMarker> takeReceipts();
+
+    bool flush();
+
+private:
+    struct Entry {
+        State state;
+        bool dirty;           // не записано в БД
+        bool receipt_pending; // не разослано участникам
+    };
+
+    // Чат в памяти, пока в нём есть загруженные пары и к нему обращались
+    struct ChatState {
+        std::uint64_t version = 0; // новое значение на каждое сообщение, см. load
+        std::int64_t last_message_id = -1;  // -1 - ещё не загружен
+        std::unordered_map<int, Entry> users;
+        int dirty_count = 0;   // пар с dirty
+        int pending_count = 0; // пар с receipt_pending
+        std::chrono::steady_clock::time_point last_used;
+        std::list<int>::iterator lru_position;
+    };
+
+    static const int LOAD_ATTEMPTS = 3;
+    static const std::chrono::seconds IDLE_TIMEOUT;
+
+    State load(int user_id, int chat_id);
+    // Всё ниже - под state_mutex
+    ChatState& chatState(int chat_id); // создаёт с новой версией, отмечает обращение
+    std::uint64_t versionOf(int chat_id) const; // нет чата - removed_version
+    void touch(ChatState& chat);
+    void setDirty(int chat_id, int user_id, ChatState& chat, Entry& entry);
+    void setReceiptPending(int chat_id, int user_id, ChatState& chat, Entry& entry);
+    void eraseChat(std::unordered_map<int, ChatState>::iterator chat);
+    void evictIdle();
+    std::int64_t getLastMessageId(int chat_id);
+    void flushLoop();
+
+    Database& database;
+    std::unordered_map<int, ChatState> chats;
+    std::list<int> lru; // спереди - недавно использованные чаты
+    std::vector<std::pair<int, int>> dirty_queue; // (chat_id, user_id), которые ждут записи в БД
+    std::vector<std::pair<int, int>> receipt_queue; // (chat_id, user_id), которые ждут рассылки
+    // Версии берутся из общего счётчика: чат, удалённый и созданный заново,
+    // не повторит версию, запомненную незавершённой загрузкой. Отсутствующий чат
+    // имеет версию последнего удаления - версия, снятая загрузкой до удаления, с ней не совпадёт
+    std::uint64_t last_version = 0;
+    std::uint64_t removed_version = 0;
+    std::mutex state_mutex;
+
+    std::chrono::milliseconds interval;
+    bool stopping;
+    std::mutex stop_mutex;
+    std::condition_variable stop_cv;
+    std::thread flusher;
+};
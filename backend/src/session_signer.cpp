@@ -0,0 +1,130 @@
+#include "session_signer.h"
+#include "token_generator.h"
+#include <chrono>
+#include <algorithm>
+#include <vector>
+
+namespace {
+const std::size_t BLOCK_SIZE = 64;
+const std::size_t DIGEST_SIZE = 20;
+const std::size_t NONCE_LENGTH = 16;
+const char* const PREFIX = "v1.";
+
+bool parseNumber(const std::string& text, std::int64_t& value) {
+    if (text.empty() || text.size() > 18) return false;
+    value = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') return false;
+        value = value * 10 + (c - '0');
+    }
+    return true;
+}
+
+bool isHex(const std::string& text, std::size_t length) {
+    if (text.size() != length) return false;
+    for (char c : text) {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return false;
+    }
+    return true;
+}
+}
+
+SessionSigner::SessionSigner(const std::string& secret) {
+    // Ключ длиннее блока сначала хешируется (RFC 2104)
+    unsigned char key[BLOCK_SIZE] = {0};
+    if (secret.size() > BLOCK_SIZE) {
+        sha1::SHA1 hash;
+        hash.processBytes(secret.data(), secret.size());
+        hash.getDigestBytes(key);
+    } else {
+        std::copy(secret.begin(), secret.end(), key);
+    }
+
+    unsigned char pad[BLOCK_SIZE];
+    for (std::size_t i = 0; i < BLOCK_SIZE; i++) pad[i] = key[i] ^ 0x36;
+    inner_base.processBytes(pad, BLOCK_SIZE);
+    for (std::size_t i = 0; i < BLOCK_SIZE; i++) pad[i] = key[i] ^ 0x5c;
+    outer_base.processBytes(pad, BLOCK_SIZE);
+}
+
+std::string SessionSigner::sign(const std::string& payload) const {
+    unsigned char digest[DIGEST_SIZE];
+
+    sha1::SHA1 inner = inner_base;
+    inner.processBytes(payload.data(), payload.size());
+    inner.getDigestBytes(digest);
+
+    sha1::SHA1 outer = outer_base;
+    outer.processBytes(digest, DIGEST_SIZE);
+    outer.getDigestBytes(digest);
+
+    return TokenGenerator::toHex(digest, DIGEST_SIZE);
+}
+
+std::string SessionSigner::issue(int user_id, std::int64_t expires_at) const {
+    unsigned char nonce[NONCE_LENGTH / 2];
+    TokenGenerator::fill(nonce, sizeof(nonce));
+
+    std::string payload = PREFIX + std::to_string(user_id) + "." + std::to_string(expires_at) + "." +
+                          TokenGenerator::toHex(nonce, sizeof(nonce));
+    return payload + "." + sign(payload);
+}
+
+bool SessionSigner::isSigned(const std::string& token) {
+    return token.compare(0, 3, PREFIX) == 0;
+}
+
+bool SessionSigner::verify(const std::string& token, Claims& claims) const {
+    if (!isSigned(token)) return false;
+
+    std::vector<std::string> parts;
+    std::size_t start = 0;
+    while (parts.size() <= 5) {
+        std::size_t dot = token.find('.', start);
+        parts.push_back(token.substr(start, dot == std::string::npos ? std::string::npos : dot - start));
+        if (dot == std::string::npos) break;
+        start = dot + 1;
+    }
+    if (parts.size() != 5 || !isHex(parts[3], NONCE_LENGTH) || !isHex(parts[4], DIGEST_SIZE * 2)) {
+        return false;
+    }
+
+    std::int64_t user_id = 0;
+    std::int64_t expires_at = 0;
+    if (!parseNumber(parts[1], user_id) || !parseNumber(parts[2], expires_at) ||
+        user_id <= 0 || user_id > 0x7fffffff) {
+        return false;
+    }
+
+    // Сравнение без раннего выхода: время не зависит от того, где подпись расходится
+    std::string expected = sign(token.substr(0, token.size() - parts[4].size() - 1));
+    unsigned char diff = 0;
+    for (std::size_t i = 0; i < expected.size(); i++) {
+        diff |= static_cast<unsigned char>(expected[i] ^ parts[4][i]);
+    }
+    if (diff != 0 || expires_at <= now()) {
+        return false;
+    }
+
+    claims.user_id = static_cast<int>(user_id);
+    claims.expires_at = expires_at;
+    claims.signature = parts[4];
+    return true;
+}
+
+std::string SessionSigner::hashToken(const std::string& token) {
+    unsigned char digest[DIGEST_SIZE];
+    sha1::SHA1 hash;
+    hash.processBytes(token.data(), token.size());
+    hash.getDigestBytes(digest);
+    return TokenGenerator::toHex(digest, DIGEST_SIZE);
+}
+
+std::string SessionSigner::generateSecret() {
+    return TokenGenerator::hex(32);
+}
+
+std::int64_t SessionSigner::now() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
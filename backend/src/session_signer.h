@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include "../../Crow/include/crow/TinySHA1.hpp"
+
+// Подписанные токены сессии: v1.<user_id>.<expires_at>.<nonce>.<hmac>
+// user_id и срок (unix-время, секунды) проверяются по HMAC-SHA1 без обращения к БД.
+// Отзыв токенов - забота вызывающего (по signature из Claims).
+class SessionSigner {
+public:
+    struct Claims {
+        int user_id = 0;
+        std::int64_t expires_at = 0;
+        std::string signature;
+    };
+
+    explicit SessionSigner(const std::string& secret);
+
+    std::string issue(int user_id, std::int64_t expires_at) const;
+    // Подпись сравнивается за постоянное время; false - подделка, порча или истёк срок
+    bool verify(const std::string& token, Claims& claims) const;
+
+    static bool isSigned(const std::string& token);
+    static std::string hashToken(const std::string& token); // SHA1 в hex, ключ таблицы sessions
+    static std::string generateSecret(); // 32 случайных байта в hex
+    static std::int64_t now();
+
+private:
+    std::string sign(const std::string& payload) const;
+
+    // Состояние SHA1 после ключа с ipad/opad, копируется на каждую подпись
+    sha1::SHA1 inner_base;
+    sha1::SHA1 outer_base;
+};
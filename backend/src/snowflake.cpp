@@ -0,0 +1,66 @@
+#include "snowflake.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+const int TIMESTAMP_SHIFT = SnowflakeGenerator::NODE_BITS + SnowflakeGenerator::SEQUENCE_BITS;
+const std::int64_t SEQUENCE_MASK = (1 << SnowflakeGenerator::SEQUENCE_BITS) - 1;
+
+std::int64_t currentMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+}
+
+SnowflakeGenerator::SnowflakeGenerator(int node_id) : node(node_id & MAX_NODE), last_id(0) {
+    if (node != node_id) {
+        std::cerr << "Snowflake node " << node_id << " is out of range, using " << node << std::endl;
+    }
+}
+
+std::int64_t SnowflakeGenerator::next() {
+    std::int64_t node_bits = static_cast<std::int64_t>(node) << SEQUENCE_BITS;
+    std::int64_t last = last_id.load(std::memory_order_relaxed);
+    while (true) {
+        std::int64_t candidate = ((currentMillis() - EPOCH_MS) << TIMESTAMP_SHIFT) | node_bits;
+        if (candidate <= last) {
+            // Та же миллисекунда или часы ушли назад: следующий счётчик,
+            // после последнего - начало следующей миллисекунды
+            candidate = (last & SEQUENCE_MASK) == SEQUENCE_MASK
+                ? (((last >> TIMESTAMP_SHIFT) + 1) << TIMESTAMP_SHIFT) | node_bits
+                : last + 1;
+        }
+        if (last_id.compare_exchange_weak(last, candidate, std::memory_order_relaxed)) {
+            return candidate;
+        }
+    }
+}
+
+void SnowflakeGenerator::seed(std::int64_t issued_id) {
+    if (nodeOf(issued_id) != node) {
+        // Чужой id: продолжать его счётчик нельзя - занимаем следующую миллисекунду
+        issued_id |= (static_cast<std::int64_t>(MAX_NODE) << SEQUENCE_BITS) | SEQUENCE_MASK;
+    }
+    std::int64_t last = last_id.load(std::memory_order_relaxed);
+    while (last < issued_id && !last_id.compare_exchange_weak(last, issued_id, std::memory_order_relaxed)) {}
+}
+
+std::int64_t SnowflakeGenerator::timestampOf(std::int64_t id) {
+    return (id >> TIMESTAMP_SHIFT) + EPOCH_MS;
+}
+
+int SnowflakeGenerator::nodeOf(std::int64_t id) {
+    return static_cast<int>((id >> SEQUENCE_BITS) & MAX_NODE);
+}
+
+int SnowflakeGenerator::nodeFromEnvironment() {
+    const char* value = std::getenv("CHAT_NODE_ID");
+    if (!value || !*value) return 0;
+    int node_id = std::atoi(value);
+    if (node_id < 0 || node_id > MAX_NODE) {
+        std::cerr << "CHAT_NODE_ID must be 0.." << MAX_NODE << ", using 0" << std::endl;
+        return 0;
+    }
+    return node_id;
+}
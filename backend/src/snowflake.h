@@ -0,0 +1,31 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// id сообщений в стиле Snowflake: | 41 бит - мс от EPOCH_MS | 5 бит - узел | 7 бит - счётчик |
+// Всего 53 бита: id точно представим числом в JavaScript, а значит, и в JSON для клиента.
+// id растут монотонно на узле (при переполнении счётчика или переводе часов назад
+// занимается следующая миллисекунда), сортировка по id - сортировка по времени.
+class SnowflakeGenerator {
+public:
+    static const std::int64_t EPOCH_MS = 1704067200000; // 2024-01-01 00:00:00 UTC
+    static const int NODE_BITS = 5;
+    static const int SEQUENCE_BITS = 7;
+    static const int MAX_NODE = (1 << NODE_BITS) - 1;
+
+    explicit SnowflakeGenerator(int node_id = 0);
+
+    std::int64_t next();
+    // Следующие id будут больше issued_id (последний id, выданный до перезапуска)
+    void seed(std::int64_t issued_id);
+    int getNode() const { return node; }
+
+    static std::int64_t timestampOf(std::int64_t id); // unix-время создания, мс
+    static int nodeOf(std::int64_t id);
+    // CHAT_NODE_ID из окружения (0..MAX_NODE), иначе 0
+    static int nodeFromEnvironment();
+
+private:
+    int node;
+    std::atomic<std::int64_t> last_id;
+};
@@ -0,0 +1,88 @@
+#include "task_executor.h"
+#include <iostream>
+
+TaskExecutor::TaskExecutor(const std::string& executor_name, std::size_t thread_count, std::size_t queue_limit)
+    : name(executor_name), max_queue(queue_limit), stopping(false), max_queue_depth(0) {
+    if (thread_count == 0) thread_count = 1;
+    for (std::size_t i = 0; i < thread_count; i++) {
+        workers.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+TaskExecutor::~TaskExecutor() {
+    shutdown();
+}
+
+bool TaskExecutor::trySubmit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (stopping || queue.size() >= max_queue) {
+            rejected++;
+            return false;
+        }
+        queue.push_back({std::move(task), std::chrono::steady_clock::now()});
+        if (queue.size() > max_queue_depth) {
+            max_queue_depth = queue.size();
+        }
+    }
+    submitted++;
+    queue_cv.notify_one();
+    return true;
+}
+
+void TaskExecutor::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (stopping) return;
+        stopping = true;
+    }
+    queue_cv.notify_all();
+    // Уже принятые задачи дорабатываются: за каждой стоит незавершённый ответ
+    for (auto& worker : workers) {
+        if (worker.joinable()) worker.join();
+    }
+}
+
+TaskExecutor::Metrics TaskExecutor::getMetrics() const {
+    Metrics metrics;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        metrics.queue_depth = queue.size();
+        metrics.max_queue_depth = max_queue_depth;
+    }
+    metrics.worker_threads = workers.size();
+    metrics.queue_capacity = max_queue;
+    metrics.busy_workers = busy_workers.load();
+    metrics.submitted = submitted.load();
+    metrics.completed = completed.load();
+    metrics.rejected = rejected.load();
+    metrics.total_wait_us = total_wait_us.load();
+    return metrics;
+}
+
+void TaskExecutor::workerLoop() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (queue.empty()) return; // stopping и очередь пуста
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        auto waited = std::chrono::steady_clock::now() - task.enqueued_at;
+        total_wait_us += std::chrono::duration_cast<std::chrono::microseconds>(waited).count();
+
+        busy_workers++;
+        try {
+            task.fn();
+        } catch (const std::exception& e) {
+            std::cerr << "EXCEPTION in " << name << " task: " << e.what() << std::endl;
+        } catch (...) {
+            std::cerr << "EXCEPTION in " << name << " task: unknown error" << std::endl;
+        }
+        busy_workers--;
+        completed++;
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Пул потоков с ограниченной очередью.
+// Используется, чтобы обращения к SQLite не выполнялись в I/O потоках Crow.
+class TaskExecutor {
+public:
+    struct Metrics {
+        std::size_t worker_threads;
+        std::size_t queue_capacity;
+        std::size_t queue_depth;
+        std::size_t max_queue_depth;
+        std::size_t busy_workers;
+        std::uint64_t submitted;
+        std::uint64_t completed;
+        std::uint64_t rejected;
+        std::uint64_t total_wait_us; // суммарное время ожидания задач в очереди
+    };
+
+    TaskExecutor(const std::string& name, std::size_t thread_count, std::size_t max_queue);
+    ~TaskExecutor();
+
+    TaskExecutor(const TaskExecutor&) = delete;
+    TaskExecutor& operator=(const TaskExecutor&) = delete;
+
+    // Возвращает false, если очередь заполнена или пул остановлен
+    bool trySubmit(std::function<void()> task);
+    void shutdown();
+
+    Metrics getMetrics() const;
+    const std::string& getName() const { return name; }
+
+private:
+    struct Task {
+        std::function<void()> fn;
+        std::chrono::steady_clock::time_point enqueued_at;
+    };
+
+    void workerLoop();
+
+    std::string name;
+    std::size_t max_queue;
+    std::vector<std::thread> workers;
+    std::deque<Task> queue;
+    mutable std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    bool stopping;
+
+    std::size_t max_queue_depth;
+    std::atomic<std::size_t> busy_workers{0};
+    std::atomic<std::uint64_t> submitted{0};
+    std::atomic<std::uint64_t> completed{0};
+    std::atomic<std::uint64_t> rejected{0};
+    std::atomic<std::uint64_t> total_wait_us{0};
+};
@@ -0,0 +1,116 @@
+#include "timer_wheel.h"
+#include <iostream>
+#include <algorithm>
+
+TimerWheel::TimerWheel(std::chrono::milliseconds tick_duration)
+    : tick(tick_duration.count() > 0 ? tick_duration : std::chrono::milliseconds(1)),
+      current(0), next_id(1), stopping(false) {
+    worker = std::thread([this]() { run(); });
+}
+
+TimerWheel::~TimerWheel() {
+    shutdown();
+}
+
+void TimerWheel::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(wheel_mutex);
+        stopping = true;
+    }
+    stop_cv.notify_all();
+    if (worker.joinable()) worker.join();
+}
+
+TimerWheel::TimerId TimerWheel::schedule(std::chrono::milliseconds delay, std::function<void()> callback) {
+    // Округляем вверх: таймер не срабатывает раньше срока
+    const std::uint64_t max_ticks = (std::uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+    std::int64_t count = delay.count() > 0 ? (delay.count() + tick.count() - 1) / tick.count() : 1;
+    std::uint64_t ticks = std::min<std::uint64_t>(static_cast<std::uint64_t>(count), max_ticks);
+    if (ticks == 0) ticks = 1;
+
+    // Таймер собирается во временном списке и переносится в ячейку через splice,
+    // так что итератор в index остаётся действительным при любых переносах
+    Slot pending;
+    std::lock_guard<std::mutex> lock(wheel_mutex);
+    TimerId id = next_id++;
+    pending.push_back(Timer{id, current + ticks, std::move(callback)});
+    place(pending, pending.begin());
+    return id;
+}
+
+void TimerWheel::place(Slot& from, Slot::iterator timer) {
+    std::uint64_t delta = timer->deadline > current ? timer->deadline - current : 0;
+    std::size_t level = 0;
+    while (level + 1 < LEVELS && delta >= (std::uint64_t(1) << (SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+
+    Slot& target = wheels[level][(timer->deadline >> (SLOT_BITS * level)) & (SLOTS - 1)];
+    target.splice(target.end(), from, timer);
+    index[timer->id] = Location{&target, timer};
+}
+
+void TimerWheel::cascade(std::size_t level) {
+    // Ячейка верхнего уровня, чей интервал начинается сейчас, раскладывается по нижним
+    Slot& slot = wheels[level][(current >> (SLOT_BITS * level)) & (SLOTS - 1)];
+    while (!slot.empty()) {
+        place(slot, slot.begin());
+    }
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    std::lock_guard<std::mutex> lock(wheel_mutex);
+    auto it = index.find(id);
+    if (it == index.end()) return false;
+    it->second.slot->erase(it->second.position);
+    index.erase(it);
+    return true;
+}
+
+std::size_t TimerWheel::size() const {
+    std::lock_guard<std::mutex> lock(wheel_mutex);
+    return index.size();
+}
+
+void TimerWheel::advance(std::vector<std::function<void()>>& expired) {
+    current++;
+    for (std::size_t level = 1; level < LEVELS; level++) {
+        if ((current & ((std::uint64_t(1) << (SLOT_BITS * level)) - 1)) != 0) break;
+        cascade(level);
+    }
+
+    // В ячейке нулевого уровня лежат только таймеры с deadline == current
+    Slot& slot = wheels[0][current & (SLOTS - 1)];
+    for (auto& timer : slot) {
+        expired.push_back(std::move(timer.callback));
+        index.erase(timer.id);
+    }
+    slot.clear();
+}
+
+void TimerWheel::run() {
+    auto next_tick = std::chrono::steady_clock::now() + tick;
+    std::unique_lock<std::mutex> lock(wheel_mutex);
+    while (!stopping) {
+        stop_cv.wait_until(lock, next_tick, [this]() { return stopping; });
+        if (stopping) break;
+
+        // Если поток проспал несколько шагов, догоняем их все
+        std::vector<std::function<void()>> expired;
+        auto now = std::chrono::steady_clock::now();
+        while (next_tick <= now) {
+            advance(expired);
+            next_tick += tick;
+        }
+
+        lock.unlock();
+        for (auto& callback : expired) {
+            try {
+                callback();
+            } catch (const std::exception& e) {
+                std::cerr << "EXCEPTION in timer callback: " << e.what() << std::endl;
+            }
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+// Иерархическое колесо таймеров: LEVELS уровней по SLOTS ячеек, ячейка уровня k
+// покрывает SLOTS^k шагов (при шаге 100 мс - от 25 секунд до ~13 лет).
+// Общее для всех таймаутов сервера: набор текста, простой, истечение сессий.
+// schedule/cancel - O(1), таймер верхнего уровня опускается вниз, когда нижний
+// уровень делает оборот. Точность - один шаг; все колбэки шага выполняются
+// пачкой в потоке колеса без его блокировки.
+class TimerWheel {
+public:
+    using TimerId = std::uint64_t;
+
+    explicit TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(100));
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    TimerId schedule(std::chrono::milliseconds delay, std::function<void()> callback);
+    bool cancel(TimerId id); // false - уже сработал или не существует
+    std::size_t size() const;
+    void shutdown(); // останавливает поток; несработавшие таймеры отбрасываются
+
+private:
+    static const unsigned SLOT_BITS = 8;
+    static const std::size_t SLOTS = std::size_t(1) << SLOT_BITS;
+    static const std::size_t LEVELS = 4;
+
+    struct Timer {
+        TimerId id;
+        std::uint64_t deadline; // номер шага срабатывания
+        std::function<void()> callback;
+    };
+    using Slot = std::list<Timer>;
+    struct Location {
+        Slot* slot;
+        Slot::iterator position;
+    };
+
+    void run();
+    void advance(std::vector<std::function<void()>>& expired);
+    void place(Slot& from, Slot::iterator timer); // переносит таймер в ячейку по его сроку
+    void cascade(std::size_t level);
+
+    const std::chrono::milliseconds tick;
+    Slot wheels[LEVELS][SLOTS];
+    std::unordered_map<TimerId, Location> index;
+    std::uint64_t current; // пройдено шагов
+    TimerId next_id;
+
+    mutable std::mutex wheel_mutex;
+    std::condition_variable stop_cv;
+    bool stopping;
+    std::thread worker;
+};
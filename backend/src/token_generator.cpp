@@ -0,0 +1,146 @@
+#include "token_generator.h"
+#include <random>
+#include <cstring>
+
+namespace {
+const std::size_t BLOCK_SIZE = 64;
+// За одно пополнение считается несколько блоков: первые KEY_SIZE байт - новый ключ
+const std::size_t BLOCKS_PER_REFILL = 4;
+const std::size_t BUFFER_SIZE = BLOCK_SIZE * BLOCKS_PER_REFILL;
+const std::size_t KEY_SIZE = 32;
+
+// "00" "01" ... "ff": один поиск по таблице на байт
+struct HexTable {
+    char pairs[512];
+    HexTable() {
+        const char digits[] = "0123456789abcdef";
+        for (int i = 0; i < 256; i++) {
+            pairs[2 * i] = digits[i >> 4];
+            pairs[2 * i + 1] = digits[i & 0x0f];
+        }
+    }
+};
+const HexTable HEX_TABLE;
+
+inline std::uint32_t rotl(std::uint32_t value, int shift) {
+    return (value << shift) | (value >> (32 - shift));
+}
+
+inline void quarterRound(std::uint32_t* x, int a, int b, int c, int d) {
+    x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 16);
+    x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 12);
+    x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 8);
+    x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 7);
+}
+
+// ChaCha20 (RFC 8439) как поток случайных байт: ключ из ОС, 64-битный счётчик блоков.
+// Ключ меняется на каждом пополнении (fast key erasure): новый ключ - начало выхода,
+// старый затирается, и из дампа памяти нельзя пересчитать уже выданные блоки.
+class ChaChaStream {
+public:
+    ChaChaStream() : used(BUFFER_SIZE) {
+        std::random_device rd;
+        state[0] = 0x61707865;
+        state[1] = 0x3320646e;
+        state[2] = 0x79622d32;
+        state[3] = 0x6b206574;
+        for (int i = 4; i < 12; i++) state[i] = rd();
+        state[12] = 0;
+        state[13] = 0;
+        state[14] = rd();
+        state[15] = rd();
+    }
+
+    void fill(unsigned char* out, std::size_t size) {
+        while (size > 0) {
+            if (used == BUFFER_SIZE) refill();
+            std::size_t chunk = BUFFER_SIZE - used < size ? BUFFER_SIZE - used : size;
+            std::memcpy(out, buffer + used, chunk);
+            // Выданные байты стираются; вместе со сменой ключа в refill дамп памяти
+            // не раскрывает прошлые токены
+            std::memset(buffer + used, 0, chunk);
+            used += chunk;
+            out += chunk;
+            size -= chunk;
+        }
+    }
+
+private:
+    void refill() {
+        for (std::size_t i = 0; i < BLOCKS_PER_REFILL; i++) {
+            generateBlock(buffer + i * BLOCK_SIZE);
+        }
+        // Новый ключ берётся из выхода и в выдачу не попадает
+        for (int i = 0; i < 8; i++) {
+            const unsigned char* word = buffer + 4 * i;
+            state[4 + i] = static_cast<std::uint32_t>(word[0]) | static_cast<std::uint32_t>(word[1]) << 8 |
+                           static_cast<std::uint32_t>(word[2]) << 16 | static_cast<std::uint32_t>(word[3]) << 24;
+        }
+        std::memset(buffer, 0, KEY_SIZE);
+        used = KEY_SIZE;
+    }
+
+    void generateBlock(unsigned char* block) {
+        std::uint32_t x[16];
+        std::memcpy(x, state, sizeof(x));
+        for (int round = 0; round < 10; round++) {
+            quarterRound(x, 0, 4, 8, 12);
+            quarterRound(x, 1, 5, 9, 13);
+            quarterRound(x, 2, 6, 10, 14);
+            quarterRound(x, 3, 7, 11, 15);
+            quarterRound(x, 0, 5, 10, 15);
+            quarterRound(x, 1, 6, 11, 12);
+            quarterRound(x, 2, 7, 8, 13);
+            quarterRound(x, 3, 4, 9, 14);
+        }
+        for (int i = 0; i < 16; i++) {
+            std::uint32_t word = x[i] + state[i];
+            block[4 * i] = static_cast<unsigned char>(word);
+            block[4 * i + 1] = static_cast<unsigned char>(word >> 8);
+            block[4 * i + 2] = static_cast<unsigned char>(word >> 16);
+            block[4 * i + 3] = static_cast<unsigned char>(word >> 24);
+        }
+        if (++state[12] == 0) state[13]++;
+    }
+
+    std::uint32_t state[16];
+    unsigned char buffer[BUFFER_SIZE];
+    std::size_t used;
+};
+
+ChaChaStream& localStream() {
+    thread_local ChaChaStream stream;
+    return stream;
+}
+}
+
+void TokenGenerator::fill(unsigned char* out, std::size_t size) {
+    localStream().fill(out, size);
+}
+
+void TokenGenerator::toHex(const unsigned char* data, std::size_t size, char* out) {
+    for (std::size_t i = 0; i < size; i++) {
+        std::memcpy(out + 2 * i, HEX_TABLE.pairs + 2 * data[i], 2);
+    }
+}
+
+std::string TokenGenerator::toHex(const unsigned char* data, std::size_t size) {
+    std::string out(size * 2, '0');
+    toHex(data, size, &out[0]);
+    return out;
+}
+
+std::string TokenGenerator::hex(std::size_t size) {
+    // Токены короткие (16-32 байта): буфер на стеке, без выделений кроме самой строки
+    unsigned char bytes[64];
+    std::string out(size * 2, '0');
+    std::size_t done = 0;
+    while (done < size) {
+        std::size_t chunk = size - done < sizeof(bytes) ? size - done : sizeof(bytes);
+        fill(bytes, chunk);
+        toHex(bytes, chunk, &out[2 * done]);
+        done += chunk;
+    }
+    std::memset(bytes, 0, sizeof(bytes));
+    return out;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Случайные байты для токенов, nonce и соли.
+// У каждого потока свой генератор ChaCha20: ключ берётся из std::random_device один раз
+// при первом вызове в потоке, дальше он обновляется из собственного выхода - без системных
+// вызовов и блокировок.
+class TokenGenerator {
+public:
+    static void fill(unsigned char* out, std::size_t size);
+    // size случайных байт в hex (2 * size символов)
+    static std::string hex(std::size_t size);
+    // Табличный hex: out должен вмещать 2 * size символов, '\0' не дописывается
+    static void toHex(const unsigned char* data, std::size_t size, char* out);
+    static std::string toHex(const unsigned char* data, std::size_t size);
+};
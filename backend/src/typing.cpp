@@ -0,0 +1,103 @@
+#include "typing.h"
+#include "json_escape.h"
+#include <algorithm>
+#include <sstream>
+
+const std::chrono::milliseconds TypingTracker::TYPING_TTL(5000);
+const std::chrono::milliseconds TypingTracker::MIN_START_INTERVAL(1000);
+
+namespace {
+// Меньше этого last_start не чистится
+const std::size_t MIN_PRUNE_SIZE = 1024;
+}
+
+TypingTracker::TypingTracker(EventHub& hub, TimerWheel& wheel)
+    : events(hub), timers(wheel), prune_at(MIN_PRUNE_SIZE), next_generation(1) {}
+
+bool TypingTracker::start(int user_id, const std::string& username, int chat_id) {
+    Key key{chat_id, user_id};
+    auto now = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(typing_mutex);
+    auto it = active.find(key);
+    if (it != active.end()) {
+        // Уже печатает: только продлеваем срок
+        timers.cancel(it->second.timer);
+        it->second.generation = next_generation++;
+        it->second.timer = scheduleExpiry(key, it->second.generation);
+        return true;
+    }
+
+    auto last = last_start.find(user_id);
+    if (last != last_start.end() && now - last->second < MIN_START_INTERVAL) {
+        return false;
+    }
+    if (last_start.size() >= prune_at) pruneStarts(now);
+    last_start[user_id] = now;
+
+    std::uint64_t generation = next_generation++;
+    active[key] = Typing{username, scheduleExpiry(key, generation), generation};
+    broadcast(key, username, true);
+    return true;
+}
+
+void TypingTracker::stop(int user_id, int chat_id) {
+    Key key{chat_id, user_id};
+
+    std::lock_guard<std::mutex> lock(typing_mutex);
+    auto it = active.find(key);
+    if (it == active.end()) return;
+
+    timers.cancel(it->second.timer);
+    std::string username = it->second.username;
+    active.erase(it);
+    releaseStart(user_id, std::chrono::steady_clock::now());
+    broadcast(key, username, false);
+}
+
+std::size_t TypingTracker::activeCount() const {
+    std::lock_guard<std::mutex> lock(typing_mutex);
+    return active.size();
+}
+
+void TypingTracker::expire(Key key, std::uint64_t generation) {
+    std::lock_guard<std::mutex> lock(typing_mutex);
+    auto it = active.find(key);
+    if (it == active.end() || it->second.generation != generation) return;
+
+    std::string username = it->second.username;
+    active.erase(it);
+    releaseStart(key.user_id, std::chrono::steady_clock::now());
+    broadcast(key, username, false);
+}
+
+// Запись, которая уже не ограничивает частоту, удаляется сразу;
+// stop раньше MIN_START_INTERVAL оставляет её до pruneStarts
+void TypingTracker::releaseStart(int user_id, std::chrono::steady_clock::time_point now) {
+    auto last = last_start.find(user_id);
+    if (last != last_start.end() && now - last->second >= MIN_START_INTERVAL) {
+        last_start.erase(last);
+    }
+}
+
+void TypingTracker::pruneStarts(std::chrono::steady_clock::time_point now) {
+    for (auto it = last_start.begin(); it != last_start.end(); ) {
+        if (now - it->second >= MIN_START_INTERVAL) it = last_start.erase(it);
+        else ++it;
+    }
+    // Порог растёт с числом живых записей: чистка остаётся амортизированно O(1) на start
+    prune_at = std::max(MIN_PRUNE_SIZE, last_start.size() * 2);
+}
+
+TimerWheel::TimerId TypingTracker::scheduleExpiry(const Key& key, std::uint64_t generation) {
+    return timers.schedule(TYPING_TTL, [this, key, generation]() { expire(key, generation); });
+}
+
+void TypingTracker::broadcast(const Key& key, const std::string& username, bool typing) {
+    std::stringstream ss;
+    ss << "{\"type\":\"typing\",\"chat_id\":" << key.chat_id
+       << ",\"user_id\":" << key.user_id
+       << ",\"username\":\"" << escapeJson(username) << "\""
+       << ",\"typing\":" << (typing ? "true" : "false") << "}";
+    events.sendToChat(key.chat_id, ss.str(), key.user_id);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include "event_hub.h"
+#include "timer_wheel.h"
+
+// Индикаторы "печатает...": только в памяти, в БД не попадают.
+// Состояние истекает само через TYPING_TTL, если клиент не прислал stop.
+// Новые start от одного пользователя рассылаются не чаще MIN_START_INTERVAL,
+// повторный start в том же чате только продлевает срок без рассылки.
+class TypingTracker {
+public:
+    static const std::chrono::milliseconds TYPING_TTL;
+    static const std::chrono::milliseconds MIN_START_INTERVAL;
+
+    TypingTracker(EventHub& events, TimerWheel& timers);
+
+    // false - отброшено ограничением частоты
+    bool start(int user_id, const std::string& username, int chat_id);
+    void stop(int user_id, int chat_id);
+
+    std::size_t activeCount() const;
+
+private:
+    struct Key {
+        int chat_id;
+        int user_id;
+        bool operator<(const Key& other) const {
+            return chat_id != other.chat_id ? chat_id < other.chat_id : user_id < other.user_id;
+        }
+    };
+    struct Typing {
+        std::string username;
+        TimerWheel::TimerId timer;
+        std::uint64_t generation; // защищает от устаревшего срабатывания таймера
+    };
+
+    void expire(Key key, std::uint64_t generation);
+    void broadcast(const Key& key, const std::string& username, bool typing);
+    TimerWheel::TimerId scheduleExpiry(const Key& key, std::uint64_t generation);
+    void releaseStart(int user_id, std::chrono::steady_clock::time_point now); // под typing_mutex
+    void pruneStarts(std::chrono::steady_clock::time_point now);               // под typing_mutex
+
+    EventHub& events;
+    TimerWheel& timers;
+    std::map<Key, Typing> active;
+    // user_id -> последняя рассылка; запись нужна только MIN_START_INTERVAL после неё
+    std::unordered_map<int, std::chrono::steady_clock::time_point> last_start;
+    std::size_t prune_at; // при таком размере last_start чистится от устаревших записей
+    std::uint64_t next_generation;
+    mutable std::mutex typing_mutex;
+};
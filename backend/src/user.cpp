@@ -1,6 +1,6 @@
 #include "user.h"
-#include <random>
-#include <sstream>
+#include "password_hasher.h"
+#include "token_generator.h"
 #include <algorithm>
 #include <iostream>
 
@@ -34,21 +34,15 @@ User::User(int id, const std::string& name, const std::string& password,
     updateSession(); // Устанавливаем время истечения сессии
 }
 
-bool User::validatePassword(const std::string& password) const {
-    return password_hash == password; // Простая проверка - в реальном проекте используйте хэши!
+bool User::validatePassword(const std::string& password, bool* needs_rehash) const {
+    bool rehash = false;
+    bool valid = PasswordHasher::verify(password, password_hash, rehash);
+    if (needs_rehash) *needs_rehash = rehash;
+    return valid;
 }
 
 std::string User::generateSessionToken() {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, 15);
-    
-    std::stringstream ss;
-    ss << std::hex;
-    for (int i = 0; i < 32; i++) {
-        ss << dis(gen);
-    }
-    return ss.str();
+    return TokenGenerator::hex(16); // 32 hex-символа
 }
 
 void User::addChat(int chat_id) {
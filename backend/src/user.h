@@ -13,7 +13,7 @@ private:
 public:
     int user_id;
     std::string username;
-    std::string password_hash; // В реальном проекте нужно хэшировать!
+    std::string password_hash; // PasswordHasher; старые записи - открытый текст
     std::string email;
     std::string session_token;
     std::vector<int> available_chats;
@@ -25,7 +25,8 @@ public:
     // Copy constructor for database returns
     User(const User& other);
     
-    bool validatePassword(const std::string& password) const;
+    // Медленная операция (PBKDF2), needs_rehash - см. PasswordHasher::verify
+    bool validatePassword(const std::string& password, bool* needs_rehash = nullptr) const;
     std::string generateSessionToken();
     void addChat(int chat_id);
     void removeChat(int chat_id);
@@ -0,0 +1,59 @@
+#include "user_names.h"
+#include <algorithm>
+#include <mutex>
+
+UserNames::UserNames(Database& db) : database(db) {}
+
+std::string UserNames::get(int user_id) {
+    {
+        std::shared_lock lock(names_mutex);
+        auto it = names.find(user_id);
+        if (it != names.end()) return it->second;
+    }
+
+    load({user_id});
+    std::shared_lock lock(names_mutex);
+    auto it = names.find(user_id);
+    return it != names.end() ? it->second : "";
+}
+
+void UserNames::fill(std::vector<Message>& messages) {
+    std::vector<int> missing;
+    {
+        std::shared_lock lock(names_mutex);
+        for (Message& message : messages) {
+            auto it = names.find(message.sender_id);
+            if (it != names.end()) {
+                message.sender_name = it->second;
+            } else {
+                missing.push_back(message.sender_id);
+            }
+        }
+    }
+    if (missing.empty()) return;
+
+    std::sort(missing.begin(), missing.end());
+    missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+    load(missing);
+
+    std::shared_lock lock(names_mutex);
+    for (Message& message : messages) {
+        if (!message.sender_name.empty()) continue;
+        auto it = names.find(message.sender_id);
+        if (it != names.end()) message.sender_name = it->second;
+    }
+}
+
+void UserNames::remember(int user_id, const std::string& username) {
+    std::unique_lock lock(names_mutex);
+    names[user_id] = username;
+}
+
+void UserNames::load(const std::vector<int>& user_ids) {
+    // Запрос идёт без блокировки: параллельная загрузка тех же имён безвредна
+    auto loaded = database.getUsernames(user_ids);
+    std::unique_lock lock(names_mutex);
+    for (auto& entry : loaded) {
+        names[entry.first] = std::move(entry.second);
+    }
+}
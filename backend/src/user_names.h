@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <shared_mutex>
+#include "database.h"
+
+// Имена пользователей по user_id в памяти - для sender_name в сообщениях.
+// Имя не меняется после регистрации, поэтому записи не устаревают;
+// недостающие имена страницы догружаются из БД одним запросом.
+class UserNames {
+public:
+    explicit UserNames(Database& database);
+
+    UserNames(const UserNames&) = delete;
+    UserNames& operator=(const UserNames&) = delete;
+
+    std::string get(int user_id);
+    void fill(std::vector<Message>& messages); // заполняет sender_name
+    void remember(int user_id, const std::string& username);
+
+private:
+    void load(const std::vector<int>& user_ids);
+
+    Database& database;
+    std::unordered_map<int, std::string> names;
+    std::shared_mutex names_mutex;
+};
@@ -1,8 +1,87 @@
 #include "webserver.h"
 #include <iostream>
 #include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
 
-WebChatServer::WebChatServer() {
+#ifdef CROW_USE_BOOST
+namespace asio = boost::asio;
+#endif
+
+namespace {
+// Размер пула БД и очереди. SQLite всё равно сериализует запись,
+// поэтому потоков немного, а очередь ограничена, чтобы не копить задержку.
+const std::size_t DB_EXECUTOR_THREADS = 4;
+const std::size_t DB_EXECUTOR_QUEUE = 1024;
+// Пул хеширования паролей: PBKDF2 занимает ядро на десятки мс, поэтому потоков не больше
+// половины ядер, а короткая очередь при наплыве входов отвечает 429, а не копит минуты ожидания.
+const std::size_t AUTH_EXECUTOR_QUEUE = 32;
+// Участников в одной странице /api/chats/<id>/members
+const int MEMBERS_PAGE_SIZE = 1000;
+// Поиск сообщений: размер страницы и глубина листания (дальше OFFSET дорожает)
+const int SEARCH_PAGE_SIZE = 20;
+const int SEARCH_MAX_PAGE_SIZE = 50;
+const int SEARCH_MAX_OFFSET = 1000;
+// Подсказки по началу имени пользователя или чата
+const std::size_t TYPEAHEAD_PAGE_SIZE = 10;
+const std::size_t TYPEAHEAD_MAX_PAGE_SIZE = 50;
+// Каталог публичных чатов
+const int DIRECTORY_PAGE_SIZE = 20;
+const int DIRECTORY_MAX_PAGE_SIZE = 50;
+
+std::size_t authExecutorThreads() {
+    return std::max(1u, std::thread::hardware_concurrency() / 2);
+}
+
+// Данные websocket-соединения (connection::userdata)
+struct EventSession {
+    int user_id;
+    std::string username;
+    int subscription_id;
+};
+
+// Общий формат чата и сообщения для /api/chats, /api/chats/<id>/messages и /api/feed
+void writeChat(crow::json::wvalue& out, const Chat& chat) {
+    out["chat_id"] = chat.chat_id;
+    out["chat_name"] = chat.chat_name;
+    out["chat_type"] = chat.chat_type;
+    out["member_count"] = chat.member_count;
+    out["is_public"] = chat.is_public;
+    out["unread_count"] = chat.unread_count;
+    if (chat.last_message_id > 0) {
+        out["last_message"]["message_id"] = chat.last_message_id;
+        out["last_message"]["timestamp"] = Message::formatTimestamp(chat.last_message_at);
+        out["last_message"]["preview"] = chat.last_message_preview;
+    }
+}
+
+void writeExecutorMetrics(crow::json::wvalue& out, const TaskExecutor::Metrics& metrics) {
+    out["worker_threads"] = metrics.worker_threads;
+    out["busy_workers"] = metrics.busy_workers;
+    out["queue_depth"] = metrics.queue_depth;
+    out["max_queue_depth"] = metrics.max_queue_depth;
+    out["queue_capacity"] = metrics.queue_capacity;
+    out["submitted"] = metrics.submitted;
+    out["completed"] = metrics.completed;
+    out["rejected"] = metrics.rejected;
+    out["avg_wait_us"] = metrics.completed > 0 ? metrics.total_wait_us / metrics.completed : 0;
+}
+
+void writeMessage(crow::json::wvalue& out, const Message& msg) {
+    out["message_id"] = msg.message_id;
+    out["sender_id"] = msg.sender_id;
+    out["sender_name"] = msg.sender_name;
+    out["content"] = msg.content;
+    out["timestamp"] = Message::formatTimestamp(msg.timestamp);
+    out["type"] = msg.message_type;
+}
+}
+
+WebChatServer::WebChatServer()
+    : db_executor("db_executor", DB_EXECUTOR_THREADS, DB_EXECUTOR_QUEUE),
+      auth_executor("auth_executor", authExecutorThreads(), AUTH_EXECUTOR_QUEUE) {
     setupRoutes();
 }
 
@@ -11,6 +90,58 @@ void WebChatServer::run(int port) {
     app.port(port).multithreaded().run();
 }
 
+void WebChatServer::respondAsync(const crow::request& req, crow::response& res,
+                                 std::function<crow::response()> handler) {
+    respondOn(db_executor, 503, req, res, std::move(handler));
+}
+
+void WebChatServer::respondOn(TaskExecutor& executor, int busy_status, const crow::request& req,
+                              crow::response& res, std::function<crow::response()> handler) {
+    // req и res живут, пока не вызван res.end(): соединение держит себя через complete_request_handler.
+    // Завершение из другого потока опирается на локальную правку Crow, см. Crow/PATCHES.md
+    bool accepted = executor.trySubmit([&req, &res, handler = std::move(handler)]() {
+        crow::response result;
+        try {
+            result = handler();
+        } catch (const std::exception& e) {
+            std::cerr << "EXCEPTION in " << req.url << ": " << e.what() << std::endl;
+            result = crow::response(500, "Server error");
+        } catch (...) {
+            // Без ответа запрос так и висел бы: res.end() ниже должен выполниться всегда
+            std::cerr << "EXCEPTION in " << req.url << ": unknown error" << std::endl;
+            result = crow::response(500, "Server error");
+        }
+        
+        auto complete = [&res, result = std::move(result)]() mutable {
+            res = std::move(result);
+            res.end();
+        };
+        if (req.io_context) {
+            asio::post(*req.io_context, std::move(complete));
+        } else {
+            complete();
+        }
+    });
+    
+    if (!accepted) {
+        res = crow::response(busy_status, "Server busy, try again later");
+        if (busy_status == 429) res.add_header("Retry-After", "1");
+        res.end();
+    }
+}
+
+crow::response WebChatServer::getMetrics() {
+    crow::json::wvalue response;
+    writeExecutorMetrics(response["db_executor"], db_executor.getMetrics());
+    writeExecutorMetrics(response["auth_executor"], auth_executor.getMetrics());
+    
+    EventHub::Metrics events = chat_manager.getEventHub().getMetrics();
+    response["events"]["connections"] = events.connections;
+    response["events"]["online_users"] = events.online_users;
+    response["events"]["events_sent"] = events.events_sent;
+    return crow::response{response};
+}
+
 std::string loadTemplate(const std::string& filename) {
     std::ifstream file(filename);
     if (!file.is_open()) {
@@ -24,7 +155,7 @@ std::string loadTemplate(const std::string& filename) {
 }
 
 crow::response WebChatServer::joinChat(const crow::request& req) {
-    User* user = nullptr;
+    std::shared_ptr<const User> user;
     if (!validateRequest(req, &user)) {
         return crow::response(401, "Invalid session");
     }
@@ -37,26 +168,17 @@ crow::response WebChatServer::joinChat(const crow::request& req) {
         std::cout << "DEBUG joinChat: User " << user->user_id 
                   << " (" << user->username << ") attempting to join chat " 
                   << chat_id << std::endl;
-        Chat* chat = chat_manager.getChatById(chat_id);
-        if (!chat) {
-            return crow::response(404, "Chat not found");
-        }
-        
-        if (!chat->is_public && !chat->isInWhitelist(user->user_id)) {
-            delete chat;
-            return crow::response(403, "This is a private chat. You need an invitation to join.");
-        }
-        
-        if (chat->hasMember(user->user_id)) {
-            delete chat;
-            return crow::response(409, "User already in this chat");
-        }
-        
-        delete chat;
-        
-        bool success = chat_manager.addUserToChat(user->user_id, chat_id);
-        if (!success) {
-            return crow::response(500, "Failed to join chat");
+        switch (chat_manager.joinChat(user->user_id, chat_id)) {
+            case JOIN_OK:
+                break;
+            case JOIN_NOT_FOUND:
+                return crow::response(404, "Chat not found");
+            case JOIN_FORBIDDEN:
+                return crow::response(403, "This is a private chat. You need an invitation to join.");
+            case JOIN_ALREADY_MEMBER:
+                return crow::response(409, "User already in this chat");
+            default:
+                return crow::response(500, "Failed to join chat");
         }
         
         crow::json::wvalue response;
@@ -72,6 +194,88 @@ crow::response WebChatServer::joinChat(const crow::request& req) {
 }
 
 
+crow::response WebChatServer::searchNames(const crow::request& req, bool users) {
+    std::shared_ptr<const User> user;
+    if (!validateRequest(req, &user)) {
+        return crow::response(401, "Invalid session");
+    }
+    
+    const char* query = req.url_params.get("q");
+    if (!query || !*query) {
+        return crow::response(400, "Search query (q) is required");
+    }
+    const char* after_param = req.url_params.get("after");
+    const char* limit_param = req.url_params.get("limit");
+    int after = after_param ? std::atoi(after_param) : 0;
+    int limit = limit_param ? std::atoi(limit_param) : 0;
+    std::size_t page = (limit > 0 && static_cast<std::size_t>(limit) <= TYPEAHEAD_MAX_PAGE_SIZE)
+        ? static_cast<std::size_t>(limit) : TYPEAHEAD_PAGE_SIZE;
+    
+    // Индекс в памяти: ответ без обращения к БД
+    auto matches = users ? chat_manager.searchUsers(query, after, page)
+                         : chat_manager.searchChats(query, after, page);
+    
+    const char* id_field = users ? "user_id" : "chat_id";
+    const char* name_field = users ? "username" : "chat_name";
+    crow::json::wvalue response;
+    response["results"] = crow::json::wvalue::list();
+    for (std::size_t i = 0; i < matches.size(); i++) {
+        response["results"][i][id_field] = matches[i].id;
+        response["results"][i][name_field] = matches[i].name;
+    }
+    if (matches.size() == page) {
+        response["next_after"] = matches.back().id; // следующая страница: ?after=<next_after>
+    }
+    
+    return crow::response{response};
+}
+
+crow::response WebChatServer::getChatDirectory(const crow::request& req) {
+    std::shared_ptr<const User> user;
+    if (!validateRequest(req, &user)) {
+        return crow::response(401, "Invalid session");
+    }
+    
+    const char* sort_param = req.url_params.get("sort");
+    std::string sort_name = sort_param ? sort_param : "members";
+    if (sort_name != "members" && sort_name != "activity") {
+        return crow::response(400, "sort must be \"members\" or \"activity\"");
+    }
+    DirectorySort sort = sort_name == "members" ? DIRECTORY_BY_MEMBERS : DIRECTORY_BY_ACTIVITY;
+    
+    // Курсор "<значение>:<chat_id>" последнего чата предыдущей страницы, без него - с начала
+    std::int64_t after_value = INT64_MAX;
+    int after_id = INT_MAX;
+    const char* after_param = req.url_params.get("after");
+    if (after_param && *after_param) {
+        const char* colon = std::strchr(after_param, ':');
+        if (!colon) {
+            return crow::response(400, "after must be <value>:<chat_id>");
+        }
+        after_value = std::atoll(after_param);
+        after_id = std::atoi(colon + 1);
+    }
+    const char* limit_param = req.url_params.get("limit");
+    int limit = limit_param ? std::atoi(limit_param) : DIRECTORY_PAGE_SIZE;
+    if (limit <= 0 || limit > DIRECTORY_MAX_PAGE_SIZE) limit = DIRECTORY_PAGE_SIZE;
+    
+    std::vector<Chat> chats = chat_manager.getPublicChats(sort, after_value, after_id, limit);
+    
+    crow::json::wvalue response;
+    response["sort"] = sort_name;
+    response["chats"] = crow::json::wvalue::list();
+    for (std::size_t i = 0; i < chats.size(); i++) {
+        writeChat(response["chats"][i], chats[i]);
+    }
+    if (static_cast<int>(chats.size()) == limit) {
+        const Chat& last = chats.back();
+        std::int64_t value = sort == DIRECTORY_BY_MEMBERS ? last.member_count : last.last_message_at;
+        response["next_after"] = std::to_string(value) + ":" + std::to_string(last.chat_id);
+    }
+    
+    return crow::response{response};
+}
+
 crow::response WebChatServer::searchChat(const crow::request& req) {
     try {
         auto json = crow::json::load(req.body);
@@ -88,7 +292,7 @@ crow::response WebChatServer::searchChat(const crow::request& req) {
         response["chat_id"] = chat->chat_id;
         response["chat_name"] = chat->chat_name;
         response["chat_type"] = chat->chat_type;
-        response["member_count"] = chat->member_ids.size();
+        response["member_count"] = chat->member_count;
         response["created_by"] = chat->created_by;
         response["is_public"] = chat->is_public;
         
@@ -100,71 +304,188 @@ crow::response WebChatServer::searchChat(const crow::request& req) {
     }
 }
 
+void WebChatServer::setupEvents() {
+    // Push-канал: ws://host/ws?token=<session_token>
+    CROW_WEBSOCKET_ROUTE(app, "/ws")
+    .onaccept([this](const crow::request& req, void** userdata) {
+        const char* token = req.url_params.get("token");
+        if (!token) return false;
+        
+        std::shared_ptr<const User> user = chat_manager.authenticate(token);
+        if (!user) return false;
+        
+        *userdata = new EventSession{user->user_id, user->username, 0};
+        return true;
+    })
+    .onopen([this](crow::websocket::connection& conn) {
+        auto* session = static_cast<EventSession*>(conn.userdata());
+        session->subscription_id = chat_manager.subscribeEvents(session->user_id,
+            [&conn](const EventHub::Payload& payload) { conn.send_text(*payload); });
+    })
+    .onmessage([this](crow::websocket::connection& conn, const std::string& data, bool is_binary) {
+        auto* session = static_cast<EventSession*>(conn.userdata());
+        if (!session || is_binary) return;
+        
+        auto json = crow::json::load(data);
+        if (!json || !json.has("type")) return;
+        
+        std::string type = json["type"].s();
+        chat_manager.touchPresence(session->user_id);
+        
+        // Клиент сообщает об активности пользователя (фокус окна и т.п.)
+        if (type == "activity") return;
+        
+        // Набор текста живёт только в памяти, поэтому обрабатывается прямо в I/O потоке
+        if (type == "typing" && json.has("chat_id")) {
+            bool is_typing = !json.has("typing") || json["typing"].b();
+            chat_manager.setTyping(session->user_id, session->username, json["chat_id"].i(), is_typing);
+            return;
+        }
+        
+        // Прочтение по websocket: то же, что POST /api/chats/<id>/read, но без ответа
+        if (type == "read" && json.has("chat_id")) {
+            int user_id = session->user_id;
+            int chat_id = json["chat_id"].i();
+            std::int64_t message_id = json.has("message_id") ? json["message_id"].i() : 0;
+            db_executor.trySubmit([this, user_id, chat_id, message_id]() {
+                ReadStateTracker::State state;
+                chat_manager.markChatRead(user_id, chat_id, message_id, state);
+            });
+        }
+    })
+    .onclose([this](crow::websocket::connection& conn, const std::string&, uint16_t) {
+        auto* session = static_cast<EventSession*>(conn.userdata());
+        if (!session) return;
+        chat_manager.unsubscribeEvents(session->user_id, session->subscription_id);
+        conn.userdata(nullptr);
+        delete session;
+    });
+}
+
 void WebChatServer::setupRoutes() {
+    setupEvents();
+    
     CROW_ROUTE(app, "/")
     ([this]() {
         std::string html = loadTemplate("templates/index.html");
         return html;
     });
     
+    CROW_ROUTE(app, "/api/metrics").methods("GET"_method)
+    ([this]() {
+        return getMetrics();
+    });
+    
     CROW_ROUTE(app, "/api/register").methods("POST"_method)
-    ([this](const crow::request& req) {
-        return registerUser(req);
+    ([this](const crow::request& req, crow::response& res) {
+        // Пароль хешируется на отдельном пуле: наплыв входов не задерживает сообщения
+        respondOn(auth_executor, 429, req, res, [this, &req]() { return registerUser(req); });
     });
     
     CROW_ROUTE(app, "/api/login").methods("POST"_method)
-    ([this](const crow::request& req) {
-        return loginUser(req);
+    ([this](const crow::request& req, crow::response& res) {
+        respondOn(auth_executor, 429, req, res, [this, &req]() { return loginUser(req); });
+    });
+    
+    CROW_ROUTE(app, "/api/logout").methods("POST"_method)
+    ([this](const crow::request& req, crow::response& res) {
+        respondAsync(req, res, [this, &req]() { return logoutUser(req); });
     });
     
     CROW_ROUTE(app, "/api/chats").methods("GET"_method)
-    ([this](const crow::request& req) {
-        return getUserChats(req);
+    ([this](const crow::request& req, crow::response& res) {
+        respondAsync(req, res, [this, &req]() { return getUserChats(req); });
+    });
+    
+    CROW_ROUTE(app, "/api/feed").methods("GET"_method)
+    ([this](const crow::request& req, crow::response& res) {
+        respondAsync(req, res, [this, &req]() { return getFeed(req); });
     });
     
     CROW_ROUTE(app, "/api/chats/<int>/messages").methods("GET"_method)
-    ([this](const crow::request& req, int chat_id) {
-        return getChatMessages(req, chat_id);
+    ([this](const crow::request& req, crow::response& res, int chat_id) {
+        respondAsync(req, res, [this, &req, chat_id]() { return getChatMessages(req, chat_id); });
+    });
+    
+    CROW_ROUTE(app, "/api/chats/<int>/members").methods("GET"_method)
+    ([this](const crow::request& req, crow::response& res, int chat_id) {
+        respondAsync(req, res, [this, &req, chat_id]() { return getChatMembers(req, chat_id); });
+    });
+    
+    CROW_ROUTE(app, "/api/chats/<int>/read").methods("POST"_method)
+    ([this](const crow::request& req, crow::response& res, int chat_id) {
+        respondAsync(req, res, [this, &req, chat_id]() { return markChatRead(req, chat_id); });
     });
     
     CROW_ROUTE(app, "/api/messages").methods("POST"_method)
-    ([this](const crow::request& req) {
-        return sendMessage(req);
+    ([this](const crow::request& req, crow::response& res) {
+        respondAsync(req, res, [this, &req]() { return sendMessage(req); });
+    });
+    
+    CROW_ROUTE(app, "/api/messages/search").methods("GET"_method)
+    ([this](const crow::request& req, crow::response& res) {
+        respondAsync(req, res, [this, &req]() { return searchMessages(req); });
     });
     
     CROW_ROUTE(app, "/api/chats/create").methods("POST"_method)
-    ([this](const crow::request& req) {
-        return createChat(req);
+    ([this](const crow::request& req, crow::response& res) {
+        respondAsync(req, res, [this, &req]() { return createChat(req); });
     });
 
     CROW_ROUTE(app, "/api/chats/create_with_privacy").methods("POST"_method)
-    ([this](const crow::request& req) {
-    return createChatWithPrivacy(req);
+    ([this](const crow::request& req, crow::response& res) {
+        respondAsync(req, res, [this, &req]() { return createChatWithPrivacy(req); });
     });
 
+    CROW_ROUTE(app, "/api/chats/direct").methods("POST"_method)
+    ([this](const crow::request& req, crow::response& res) {
+        respondAsync(req, res, [this, &req]() { return openDirectChat(req); });
+    });
+    
     CROW_ROUTE(app, "/api/chats/<int>/invite").methods("POST"_method)
-    ([this](const crow::request& req, int chat_id) {
-    return inviteUserToChat(req, chat_id);
+    ([this](const crow::request& req, crow::response& res, int chat_id) {
+        respondAsync(req, res, [this, &req, chat_id]() { return inviteUserToChat(req, chat_id); });
+    });
+    
+    CROW_ROUTE(app, "/api/chats/<int>/admins").methods("POST"_method)
+    ([this](const crow::request& req, crow::response& res, int chat_id) {
+        respondAsync(req, res, [this, &req, chat_id]() { return addChatAdmin(req, chat_id); });
     });
     
     CROW_ROUTE(app, "/api/chats/<int>/add_user").methods("POST"_method)
-    ([this](const crow::request& req, int chat_id) {
-        return addUserToChat(req, chat_id);
+    ([this](const crow::request& req, crow::response& res, int chat_id) {
+        respondAsync(req, res, [this, &req, chat_id]() { return addUserToChat(req, chat_id); });
     });
 
-    CROW_ROUTE(app, "/api/chats/search").methods("POST"_method)
+    // Подсказки отвечает индекс в памяти: сразу в потоке Crow, не занимая очередь db_executor
+    CROW_ROUTE(app, "/api/users/search").methods("GET"_method)
+    ([this](const crow::request& req) {
+        return searchNames(req, true);
+    });
+    
+    CROW_ROUTE(app, "/api/chats/lookup").methods("GET"_method)
     ([this](const crow::request& req) {
-        return searchChat(req);
+        return searchNames(req, false);
+    });
+    
+    CROW_ROUTE(app, "/api/chats/directory").methods("GET"_method)
+    ([this](const crow::request& req, crow::response& res) {
+        respondAsync(req, res, [this, &req]() { return getChatDirectory(req); });
+    });
+    
+    CROW_ROUTE(app, "/api/chats/search").methods("POST"_method)
+    ([this](const crow::request& req, crow::response& res) {
+        respondAsync(req, res, [this, &req]() { return searchChat(req); });
     });
 
     CROW_ROUTE(app, "/api/chats/join").methods("POST"_method)
-    ([this](const crow::request& req) {
-        return joinChat(req);
+    ([this](const crow::request& req, crow::response& res) {
+        respondAsync(req, res, [this, &req]() { return joinChat(req); });
     });
 }
 
 crow::response WebChatServer::createChatWithPrivacy(const crow::request& req) {
-    User* user = nullptr;
+    std::shared_ptr<const User> user;
     if (!validateRequest(req, &user)) {
         return crow::response(401, "Invalid session");
     }
@@ -175,12 +496,16 @@ crow::response WebChatServer::createChatWithPrivacy(const crow::request& req) {
         
         std::string chat_name = json["chat_name"].s();
         bool is_public = json["is_public"].b();
+        std::string chat_type = json.has("chat_type") ? std::string(json["chat_type"].s()) : "group";
         
         if (chat_name.empty()) {
             return crow::response(400, "Chat name cannot be empty");
         }
+        if (chat_type != "group" && chat_type != "channel") {
+            return crow::response(400, "chat_type must be \"group\" or \"channel\"");
+        }
         
-        int chat_id = chat_manager.createChat(chat_name, user->user_id, "group", is_public);
+        int chat_id = chat_manager.createChat(chat_name, user->user_id, chat_type, is_public);
         
         if (chat_id == -1) {
             return crow::response(500, "Failed to create chat");
@@ -189,6 +514,7 @@ crow::response WebChatServer::createChatWithPrivacy(const crow::request& req) {
         crow::json::wvalue response;
         response["chat_id"] = chat_id;
         response["is_public"] = is_public;
+        response["chat_type"] = chat_type;
         response["message"] = std::string("Chat created successfully (") + 
                               (is_public ? "public" : "private") + ")";
         return crow::response{response};
@@ -198,8 +524,40 @@ crow::response WebChatServer::createChatWithPrivacy(const crow::request& req) {
     }
 }
 
+crow::response WebChatServer::openDirectChat(const crow::request& req) {
+    std::shared_ptr<const User> user;
+    if (!validateRequest(req, &user)) {
+        return crow::response(401, "Invalid session");
+    }
+    
+    try {
+        auto json = crow::json::load(req.body);
+        if (!json) return crow::response(400, "Invalid JSON");
+        
+        int peer_id = json["user_id"].i();
+        if (peer_id == user->user_id) {
+            return crow::response(400, "Cannot open a direct chat with yourself");
+        }
+        
+        // Существующий чат пары или новый - повторные запросы возвращают тот же chat_id
+        bool created = false;
+        int chat_id = chat_manager.openDirectChat(user->user_id, peer_id, created);
+        if (chat_id == -1) {
+            return crow::response(404, "User not found");
+        }
+        
+        crow::json::wvalue response;
+        response["chat_id"] = chat_id;
+        response["created"] = created;
+        return crow::response{response};
+        
+    } catch (const std::exception& e) {
+        return crow::response(500, "Server error");
+    }
+}
+
 crow::response WebChatServer::inviteUserToChat(const crow::request& req, int chat_id) {
-    User* user = nullptr;
+    std::shared_ptr<const User> user;
     if (!validateRequest(req, &user)) {
         return crow::response(401, "Invalid session");
     }
@@ -215,18 +573,21 @@ crow::response WebChatServer::inviteUserToChat(const crow::request& req, int cha
             return crow::response(404, "Chat not found");
         }
         
-        if (chat->is_public) {
-            delete chat;
+        bool is_public = chat->is_public;
+        bool is_direct = chat->chat_type == "direct";
+        delete chat;
+        
+        if (is_public) {
             return crow::response(400, "Cannot invite to public chat");
         }
+        if (is_direct) {
+            return crow::response(400, "Cannot invite to direct chat");
+        }
         
-        if (!chat->hasMember(user->user_id)) {
-            delete chat;
+        if (!chat_manager.isUserInChat(user->user_id, chat_id)) {
             return crow::response(403, "You are not a member of this chat");
         }
         
-        delete chat;
-        
         bool success = chat_manager.addToWhitelist(chat_id, target_user_id, user->user_id);
         if (!success) {
             return crow::response(500, "Failed to invite user");
@@ -278,7 +639,11 @@ crow::response WebChatServer::loginUser(const crow::request& req) {
         std::string username = json["username"].s();
         std::string password = json["password"].s();
         
-        std::string session_token = chat_manager.loginUser(username, password);
+        // Устройство для списка сессий: из тела или по User-Agent
+        std::string device = json.has("device") ? std::string(json["device"].s()) : req.get_header_value("User-Agent");
+        if (device.size() > 200) device.resize(200);
+        
+        std::string session_token = chat_manager.loginUser(username, password, device);
         if (session_token.empty()) {
             return crow::response(401, "Invalid credentials");
         }
@@ -301,8 +666,19 @@ crow::response WebChatServer::loginUser(const crow::request& req) {
     }
 }
 
+crow::response WebChatServer::logoutUser(const crow::request& req) {
+    std::string session_token = getSessionToken(req);
+    if (session_token.empty() || !chat_manager.logoutUser(session_token)) {
+        return crow::response(401, "Invalid session");
+    }
+    
+    crow::json::wvalue response;
+    response["message"] = "Logged out";
+    return crow::response{response};
+}
+
 crow::response WebChatServer::getUserChats(const crow::request& req) {
-    User* user = nullptr;
+    std::shared_ptr<const User> user;
     if (!validateRequest(req, &user)) {
         return crow::response(401, "Invalid session");
     }
@@ -314,11 +690,7 @@ crow::response WebChatServer::getUserChats(const crow::request& req) {
     
     int i = 0;
     for (const auto& chat : user_chats) {
-        response["chats"][i] = crow::json::wvalue();
-        response["chats"][i]["chat_id"] = chat.chat_id;
-        response["chats"][i]["chat_name"] = chat.chat_name;
-        response["chats"][i]["chat_type"] = chat.chat_type;
-        response["chats"][i]["member_count"] = chat.member_ids.size();
+        writeChat(response["chats"][i], chat);
         i++;
     }
     
@@ -328,7 +700,7 @@ crow::response WebChatServer::getUserChats(const crow::request& req) {
 }
 
 crow::response WebChatServer::getChatMessages(const crow::request& req, int chat_id) {
-    User* user = nullptr;
+    std::shared_ptr<const User> user;
     if (!validateRequest(req, &user)) {
         return crow::response(401, "Invalid session");
     }
@@ -338,20 +710,127 @@ crow::response WebChatServer::getChatMessages(const crow::request& req, int chat
     
     int i = 0;
     for (const auto& msg : messages) {
-        response["messages"][i]["message_id"] = msg.message_id;
-        response["messages"][i]["sender_id"] = msg.sender_id;
-        response["messages"][i]["sender_name"] = msg.sender_name;
-        response["messages"][i]["content"] = msg.content;
-        response["messages"][i]["timestamp"] = msg.timestamp;
-        response["messages"][i]["type"] = msg.message_type;
+        writeMessage(response["messages"][i], msg);
+        i++;
+    }
+    
+    return crow::response{response};
+}
+
+crow::response WebChatServer::getFeed(const crow::request& req) {
+    std::shared_ptr<const User> user;
+    if (!validateRequest(req, &user)) {
+        return crow::response(401, "Invalid session");
+    }
+    
+    // Всё для первого экрана одним ответом: список чатов уже отсортирован
+    // по последнему сообщению, первая страница берётся из кэша сообщений
+    auto user_chats = chat_manager.getUserChats(user->user_id);
+    crow::json::wvalue response;
+    response["chats"] = crow::json::wvalue::list();
+    response["messages"] = crow::json::wvalue::list();
+    
+    int i = 0;
+    for (const auto& chat : user_chats) {
+        writeChat(response["chats"][i], chat);
+        i++;
+    }
+    
+    if (user_chats.empty()) {
+        response["current_chat_id"] = nullptr;
+        return crow::response{response};
+    }
+    
+    int current_chat_id = user_chats.front().chat_id;
+    response["current_chat_id"] = current_chat_id;
+    
+    auto messages = chat_manager.getChatMessages(current_chat_id, user->user_id);
+    i = 0;
+    for (const auto& msg : messages) {
+        writeMessage(response["messages"][i], msg);
         i++;
     }
     
     return crow::response{response};
 }
 
+crow::response WebChatServer::getChatMembers(const crow::request& req, int chat_id) {
+    std::shared_ptr<const User> user;
+    if (!validateRequest(req, &user)) {
+        return crow::response(401, "Invalid session");
+    }
+    
+    // Список участников отдаём отдельно: в /api/chats только member_count
+    if (!chat_manager.isUserInChat(user->user_id, chat_id)) {
+        return crow::response(403, "You are not a member of this chat");
+    }
+    
+    // Постранично по user_id: в канале могут быть сотни тысяч подписчиков
+    const char* after_param = req.url_params.get("after");
+    const char* limit_param = req.url_params.get("limit");
+    int after = after_param ? std::atoi(after_param) : 0;
+    int limit = limit_param ? std::atoi(limit_param) : MEMBERS_PAGE_SIZE;
+    if (limit <= 0 || limit > MEMBERS_PAGE_SIZE) limit = MEMBERS_PAGE_SIZE;
+    
+    std::vector<int> page = chat_manager.getChatMembersPage(chat_id, after, limit);
+    MemberSet members(page);
+    // Статус есть только у подключённых, остальные участники - offline без обращения к presence
+    MemberSet connected = chat_manager.getConnectedMembers(members);
+    crow::json::wvalue response;
+    response["chat_id"] = chat_id;
+    response["member_ids"] = crow::json::wvalue::list();
+    response["members"] = crow::json::wvalue::list();
+    response["connected_count"] = connected.size();
+    if (static_cast<int>(page.size()) == limit) {
+        response["next_after"] = page.back(); // следующая страница: ?after=<next_after>
+    }
+    
+    // Текущее присутствие - снимок, дальше клиент обновляет его по событиям presence
+    int i = 0;
+    members.forEach([&](int member_id) {
+        response["member_ids"][i] = member_id;
+        response["members"][i]["user_id"] = member_id;
+        response["members"][i]["status"] = connected.contains(member_id)
+            ? chat_manager.getPresence(member_id) : std::string("offline");
+        i++;
+    });
+    
+    return crow::response{response};
+}
+
+crow::response WebChatServer::markChatRead(const crow::request& req, int chat_id) {
+    std::shared_ptr<const User> user;
+    if (!validateRequest(req, &user)) {
+        return crow::response(401, "Invalid session");
+    }
+    
+    try {
+        // Тело необязательно: без message_id чат читается целиком
+        std::int64_t message_id = 0;
+        if (!req.body.empty()) {
+            auto json = crow::json::load(req.body);
+            if (!json) return crow::response(400, "Invalid JSON");
+            if (json.has("message_id")) message_id = json["message_id"].i();
+        }
+        
+        ReadStateTracker::State state;
+        if (!chat_manager.markChatRead(user->user_id, chat_id, message_id, state)) {
+            return crow::response(403, "You are not a member of this chat");
+        }
+        
+        crow::json::wvalue response;
+        response["chat_id"] = chat_id;
+        response["last_read_message_id"] = state.last_read_message_id;
+        response["unread_count"] = state.unread_count;
+        return crow::response{response};
+        
+    } catch (const std::exception& e) {
+        return crow::response(500, "Server error");
+    }
+}
+
 crow::response WebChatServer::sendMessage(const crow::request& req) {
-    User* user = nullptr;
+    std::shared_ptr<const User> user;
     if (!validateRequest(req, &user)) {
         return crow::response(401, "Invalid session");
     }
@@ -381,8 +860,51 @@ crow::response WebChatServer::sendMessage(const crow::request& req) {
     }
 }
 
+crow::response WebChatServer::searchMessages(const crow::request& req) {
+    std::shared_ptr<const User> user;
+    if (!validateRequest(req, &user)) {
+        return crow::response(401, "Invalid session");
+    }
+    
+    const char* query = req.url_params.get("q");
+    if (!query || !*query) {
+        return crow::response(400, "Search query (q) is required");
+    }
+    const char* chat_param = req.url_params.get("chat_id");
+    const char* limit_param = req.url_params.get("limit");
+    const char* offset_param = req.url_params.get("offset");
+    int chat_id = chat_param ? std::atoi(chat_param) : 0;
+    int limit = limit_param ? std::atoi(limit_param) : SEARCH_PAGE_SIZE;
+    int offset = offset_param ? std::atoi(offset_param) : 0;
+    if (limit <= 0 || limit > SEARCH_MAX_PAGE_SIZE) limit = SEARCH_PAGE_SIZE;
+    if (offset < 0 || offset > SEARCH_MAX_OFFSET) {
+        return crow::response(400, "offset is out of range");
+    }
+    
+    auto results = chat_manager.searchMessages(user->user_id, query, chat_id, limit, offset);
+    crow::json::wvalue response;
+    response["results"] = crow::json::wvalue::list();
+    
+    int i = 0;
+    for (const auto& msg : results) {
+        auto& out = response["results"][i];
+        out["message_id"] = msg.message_id;
+        out["chat_id"] = msg.chat_id;
+        out["sender_id"] = msg.sender_id;
+        out["sender_name"] = msg.sender_name;
+        out["snippet"] = msg.content;
+        out["timestamp"] = Message::formatTimestamp(msg.timestamp);
+        i++;
+    }
+    if (static_cast<int>(results.size()) == limit && offset + limit <= SEARCH_MAX_OFFSET) {
+        response["next_offset"] = offset + limit;
+    }
+    
+    return crow::response{response};
+}
+
 crow::response WebChatServer::createChat(const crow::request& req) {
-    User* user = nullptr;
+    std::shared_ptr<const User> user;
     if (!validateRequest(req, &user)) {
         return crow::response(401, "Invalid session");
     }
@@ -410,8 +932,37 @@ crow::response WebChatServer::createChat(const crow::request& req) {
     }
 }
 
+crow::response WebChatServer::addChatAdmin(const crow::request& req, int chat_id) {
+    std::shared_ptr<const User> user;
+    if (!validateRequest(req, &user)) {
+        return crow::response(401, "Invalid session");
+    }
+    
+    try {
+        auto json = crow::json::load(req.body);
+        if (!json) return crow::response(400, "Invalid JSON");
+        
+        int target_user_id = json["user_id"].i();
+        
+        if (!chat_manager.isChatAdmin(user->user_id, chat_id)) {
+            return crow::response(403, "Only chat admins can appoint admins");
+        }
+        
+        if (!chat_manager.setChatAdmin(chat_id, target_user_id, user->user_id)) {
+            return crow::response(404, "User is not a member of this chat");
+        }
+        
+        crow::json::wvalue response;
+        response["message"] = "User is now a chat admin";
+        return crow::response{response};
+        
+    } catch (const std::exception& e) {
+        return crow::response(500, "Server error");
+    }
+}
+
 crow::response WebChatServer::addUserToChat(const crow::request& req, int chat_id) {
-    User* user = nullptr;
+    std::shared_ptr<const User> user;
     if (!validateRequest(req, &user)) {
         return crow::response(401, "Invalid session");
     }
@@ -422,9 +973,17 @@ crow::response WebChatServer::addUserToChat(const crow::request& req, int chat_i
         
         int target_user_id = json["user_id"].i();
         
-        bool success = chat_manager.addUserToChat(target_user_id, chat_id);
-        if (!success) {
-            return crow::response(404, "User or chat not found");
+        switch (chat_manager.joinChat(target_user_id, chat_id)) {
+            case JOIN_OK:
+                break;
+            case JOIN_NOT_FOUND:
+                return crow::response(404, "User or chat not found");
+            case JOIN_FORBIDDEN:
+                return crow::response(403, "User is not invited to this private chat");
+            case JOIN_ALREADY_MEMBER:
+                return crow::response(409, "User already in this chat");
+            default:
+                return crow::response(500, "Failed to add user to chat");
         }
         
         crow::json::wvalue response;
@@ -444,12 +1003,14 @@ std::string WebChatServer::getSessionToken(const crow::request& req) const {
     return "";
 }
 
-bool WebChatServer::validateRequest(const crow::request& req, User** user) {
+bool WebChatServer::validateRequest(const crow::request& req, std::shared_ptr<const User>* user) {
     std::string session_token = getSessionToken(req);
     if (session_token.empty()) return false;
     
-    User* found_user = chat_manager.getUserBySession(session_token);
+    // Пользователь из кэша ChatManager: запись живёт, пока её держит запрос
+    std::shared_ptr<const User> found_user = chat_manager.authenticate(session_token);
     if (!found_user) return false;
+    chat_manager.touchPresence(found_user->user_id);
     
     if (user) *user = found_user;
     return true;
@@ -2,11 +2,15 @@
 
 #include "../../Crow/include/crow.h"
 #include "chat_manager.h"
+#include "task_executor.h"
+#include <functional>
 
 class WebChatServer {
 private:
     crow::SimpleApp app;
     ChatManager chat_manager;
+    TaskExecutor db_executor; // все обращения к БД идут сюда, а не в I/O потоки Crow
+    TaskExecutor auth_executor; // вход и регистрация: хеширование паролей не занимает db_executor
     
 public:
     WebChatServer();
@@ -14,19 +18,36 @@ public:
     
 private:
     void setupRoutes();
+    void setupEvents(); // websocket /ws для push-событий
+    
+    // Выполняет handler на пуле БД и завершает ответ в io_context соединения
+    void respondAsync(const crow::request& req, crow::response& res, std::function<crow::response()> handler);
+    // То же на заданном пуле; при переполненной очереди отвечает busy_status
+    void respondOn(TaskExecutor& executor, int busy_status, const crow::request& req, crow::response& res,
+                   std::function<crow::response()> handler);
+    crow::response getMetrics();
     
     crow::response registerUser(const crow::request& req);
     crow::response loginUser(const crow::request& req);
+    crow::response logoutUser(const crow::request& req); // отзывает токен из заголовка
     crow::response getUserChats(const crow::request& req);
     crow::response getChatMessages(const crow::request& req, int chat_id);
+    crow::response getChatMembers(const crow::request& req, int chat_id);
+    crow::response getFeed(const crow::request& req); // чаты + первая страница текущего чата
+    crow::response markChatRead(const crow::request& req, int chat_id);
     crow::response sendMessage(const crow::request& req);
+    crow::response searchMessages(const crow::request& req);
     crow::response createChat(const crow::request& req);
     crow::response createChatWithPrivacy(const crow::request& req);
+    crow::response openDirectChat(const crow::request& req);
     crow::response addUserToChat(const crow::request& req, int chat_id);
     crow::response searchChat(const crow::request& req);
+    crow::response searchNames(const crow::request& req, bool users); // подсказки по началу имени
+    crow::response getChatDirectory(const crow::request& req); // каталог публичных чатов
     crow::response joinChat(const crow::request& req);
     crow::response inviteUserToChat(const crow::request& req, int chat_id);
+    crow::response addChatAdmin(const crow::request& req, int chat_id);
     
     std::string getSessionToken(const crow::request& req) const;
-    bool validateRequest(const crow::request& req, User** user = nullptr);
+    bool validateRequest(const crow::request& req, std::shared_ptr<const User>* user = nullptr);
 };
\ No newline at end of file
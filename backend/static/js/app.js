@@ -2,10 +2,17 @@ class WebChat {
     constructor() {
         this.sessionToken = localStorage.getItem('chat_session_token') || '';
         this.currentUser = localStorage.getItem('chat_current_user') || null;
+        this.currentUserId = localStorage.getItem('chat_current_user_id') || null;
         this.currentChat = null;
         this.chats = [];
         this.users = [];
         this.pollingInterval = null;
+        this.events = null;        // websocket /ws
+        this.readReceipts = {};    // chat_id -> { user_id -> message_id }
+        this.typingUsers = {};     // chat_id -> { user_id -> username }
+        this.presence = {};        // user_id -> online / idle / offline
+        this.lastActivitySent = 0;
+        this.lastTypingSent = 0;
         
         // Try auto-login if session exists
         if (this.sessionToken && this.currentUser) {
@@ -54,10 +61,11 @@ class WebChat {
     async tryAutoLogin() {
         if (this.sessionToken && this.currentUser) {
             try {
-                // Check if session is still valid
-                await this.apiCall('/api/validate_session');
-                this.showChatScreen();
+                // Check if session is still valid: feed answers 401 otherwise
+                const feed = await this.apiCall('/api/feed');
+                this.showChatScreen(feed);
                 this.startPolling();
+                this.connectEvents();
                 console.log('Auto-login successful');
             } catch (error) {
                 // Session invalid, clear storage
@@ -86,6 +94,7 @@ class WebChat {
             
             this.showChatScreen();
             this.startPolling();
+            this.connectEvents();
             this.showMessage('Login successful!', 'success');
         } catch (error) {
             this.showMessage(error.message, 'error');
@@ -107,11 +116,21 @@ class WebChat {
     }
 
     logout() {
+        // Отзываем токен на сервере; ответ не важен (токен мог уже истечь)
+        if (this.sessionToken) {
+            fetch('/api/logout', {
+                method: 'POST',
+                headers: { 'Authorization': `Bearer ${this.sessionToken}` }
+            }).catch(() => {});
+        }
         this.sessionToken = '';
         this.currentUser = null;
         this.currentChat = null;
         this.chats = [];
         this.stopPolling();
+        this.disconnectEvents();
+        this.readReceipts = {};
+        this.typingUsers = {};
         
         // Clear localStorage
         localStorage.removeItem('chat_session_token');
@@ -154,6 +173,29 @@ class WebChat {
         }
     }
     
+    // Первый экран одним запросом: чаты + сообщения самого свежего чата
+    async loadFeed() {
+        try {
+            const feed = await this.apiCall('/api/feed');
+            this.applyFeed(feed);
+        } catch (error) {
+            console.error('Failed to load feed:', error);
+            await this.loadChats();
+        }
+    }
+
+    applyFeed(feed) {
+        this.chats = Array.isArray(feed.chats) ? feed.chats : [];
+        this.renderChats();
+        
+        if (feed.current_chat_id) {
+            this.selectChat(feed.current_chat_id, feed.messages || []);
+        } else {
+            this.currentChat = null;
+            this.clearChatInterface();
+        }
+    }
+    
     async createChat(chatName, isPublic = true) {
         console.log('Creating chat:', chatName, 'Public:', isPublic);
         try {
@@ -212,7 +254,7 @@ class WebChat {
         `;
     }
 
-    async selectChat(chatId) {
+    async selectChat(chatId, preloadedMessages = null) {
         // Don't do anything if selecting the same chat
         if (this.currentChat && this.currentChat.chat_id === chatId) {
             return;
@@ -240,7 +282,13 @@ class WebChat {
             const selectedChat = document.querySelector(`[data-chat-id="${chatId}"]`);
             if (selectedChat) selectedChat.classList.add('active');
             
-            await this.loadMessages();
+            if (preloadedMessages) {
+                this.renderMessages(preloadedMessages);
+                this.markChatRead(preloadedMessages);
+            } else {
+                await this.loadMessages();
+            }
+            this.loadPresence(chatId);
         } else {
             console.error('Chat not found:', chatId);
         }
@@ -255,6 +303,7 @@ class WebChat {
         try {
             const data = await this.apiCall(`/api/chats/${this.currentChat.chat_id}/messages`);
             this.renderMessages(data.messages || []);
+            this.markChatRead(data.messages || []);
         } catch (error) {
             console.error('Failed to load messages:', error);
             // Show empty messages on error
@@ -262,11 +311,37 @@ class WebChat {
         }
     }
 
+    // Отмечаем прочитанным последнее показанное сообщение (только если оно новое)
+    async markChatRead(messages) {
+        const chat = this.currentChat;
+        if (!chat || messages.length === 0) return;
+        
+        const lastId = messages[messages.length - 1].message_id;
+        if (chat.last_read_message_id >= lastId) return;
+        chat.last_read_message_id = lastId;
+        
+        try {
+            const data = await this.apiCall(`/api/chats/${chat.chat_id}/read`, {
+                method: 'POST',
+                body: JSON.stringify({ message_id: lastId })
+            });
+            if (chat.unread_count !== data.unread_count) {
+                chat.unread_count = data.unread_count;
+                this.renderChats();
+                const selected = document.querySelector(`[data-chat-id="${chat.chat_id}"]`);
+                if (selected) selected.classList.add('active');
+            }
+        } catch (error) {
+            console.error('Failed to mark chat as read:', error);
+        }
+    }
+
     async sendMessage() {
         const input = document.getElementById('message-input');
         const content = input.value.trim();
         
         if (!content || !this.currentChat) return;
+        this.lastTypingSent = 0; // сервер снимает индикатор при отправке
         
         try {
             await this.apiCall('/api/messages', {
@@ -414,8 +489,15 @@ class WebChat {
             const chatElement = document.createElement('div');
             chatElement.className = 'chat-item';
             chatElement.setAttribute('data-chat-id', chat.chat_id);
+            const preview = chat.last_message
+                ? `<div class="chat-preview">${this.escapeHtml(chat.last_message.preview)}</div>`
+                : '';
+            const unread = chat.unread_count > 0
+                ? `<span class="unread-badge">${chat.unread_count}</span>`
+                : '';
             chatElement.innerHTML = `
-                <div><strong>${chat.chat_name}</strong></div>
+                <div><strong>${chat.chat_name}</strong>${unread}</div>
+                ${preview}
                 <small>ID: ${chat.chat_id} • ${chat.member_count} members</small>
             `;
             chatElement.onclick = () => this.selectChat(chat.chat_id);
@@ -447,14 +529,20 @@ class WebChat {
         messages.forEach(msg => {
             const messageElement = document.createElement('div');
             messageElement.className = `message-item ${msg.sender_name === this.currentUser ? 'own' : 'other'}`;
+            messageElement.dataset.messageId = msg.message_id;
+            messageElement.dataset.senderId = msg.sender_id;
             messageElement.innerHTML = `
-                <div class="message-sender">${msg.sender_name}</div>
+                <div class="message-sender"><span class="presence-dot"></span>${msg.sender_name}</div>
                 <div class="message-content">${this.escapeHtml(msg.content)}</div>
                 <div class="message-time">${msg.timestamp}</div>
             `;
             messagesContainer.appendChild(messageElement);
         });
         
+        this.updateReadMarks();
+        this.updatePresenceMarks();
+        this.renderTyping();
+        
         // Scroll to bottom
         messagesContainer.scrollTop = messagesContainer.scrollHeight;
     }
@@ -465,7 +553,7 @@ class WebChat {
         document.getElementById('chat-screen').style.display = 'none';
     }
 
-    showChatScreen() {
+    showChatScreen(feed = null) {
         document.getElementById('login-screen').style.display = 'none';
         document.getElementById('chat-screen').style.display = 'block';
         
@@ -494,7 +582,11 @@ class WebChat {
         this.currentChat = null;
         this.clearChatInterface();
         
-        this.loadChats();
+        if (feed) {
+            this.applyFeed(feed);
+        } else {
+            this.loadFeed();
+        }
         this.loadUsers();
     }
 
@@ -648,6 +740,121 @@ class WebChat {
         });
     }
 
+    // Push events (read receipts)
+    connectEvents() {
+        if (this.events || !this.sessionToken) return;
+        
+        const protocol = location.protocol === 'https:' ? 'wss' : 'ws';
+        const socket = new WebSocket(`${protocol}://${location.host}/ws?token=${encodeURIComponent(this.sessionToken)}`);
+        socket.onmessage = (event) => {
+            try {
+                this.handleEvent(JSON.parse(event.data));
+            } catch (error) {
+                console.error('Bad event:', error);
+            }
+        };
+        socket.onclose = () => {
+            this.events = null;
+            // Переподключаемся, пока пользователь в системе
+            if (this.sessionToken) setTimeout(() => this.connectEvents(), 5000);
+        };
+        this.events = socket;
+    }
+
+    disconnectEvents() {
+        if (this.events) {
+            const socket = this.events;
+            this.events = null;
+            socket.onclose = null;
+            socket.close();
+        }
+    }
+
+    handleEvent(event) {
+        if (event.type === 'typing') {
+            const users = this.typingUsers[event.chat_id] || {};
+            if (event.typing) {
+                users[event.user_id] = event.username;
+            } else {
+                delete users[event.user_id];
+            }
+            this.typingUsers[event.chat_id] = users;
+            this.renderTyping();
+        } else if (event.type === 'read_receipts') {
+            const receipts = this.readReceipts[event.chat_id] || {};
+            event.receipts.forEach(r => {
+                receipts[r.user_id] = Math.max(receipts[r.user_id] || 0, r.message_id);
+            });
+            this.readReceipts[event.chat_id] = receipts;
+            if (this.currentChat && this.currentChat.chat_id === event.chat_id) {
+                this.updateReadMarks();
+            }
+        } else if (event.type === 'presence') {
+            event.users.forEach(u => { this.presence[u.user_id] = u.status; });
+            this.updatePresenceMarks();
+        }
+    }
+
+    // Снимок присутствия участников; дальше обновляется событиями presence
+    async loadPresence(chatId) {
+        try {
+            const data = await this.apiCall(`/api/chats/${chatId}/members`);
+            (data.members || []).forEach(m => { this.presence[m.user_id] = m.status; });
+            this.updatePresenceMarks();
+        } catch (error) {
+            console.error('Error loading presence:', error);
+        }
+    }
+
+    updatePresenceMarks() {
+        document.querySelectorAll('.message-item[data-sender-id]').forEach(item => {
+            const status = this.presence[item.dataset.senderId] || 'offline';
+            item.classList.remove('presence-online', 'presence-idle', 'presence-offline');
+            item.classList.add(`presence-${status}`);
+        });
+    }
+
+    // Активность без набора текста (фокус окна), не чаще раза в минуту
+    notifyActivity() {
+        if (!this.events || this.events.readyState !== WebSocket.OPEN) return;
+        const now = Date.now();
+        if (now - this.lastActivitySent < 60000) return;
+        this.lastActivitySent = now;
+        this.events.send(JSON.stringify({ type: 'activity' }));
+    }
+
+    renderTyping() {
+        const indicator = document.getElementById('typing-indicator');
+        if (!indicator) return;
+        const users = this.currentChat ? Object.values(this.typingUsers[this.currentChat.chat_id] || {}) : [];
+        indicator.textContent = users.length === 0 ? ''
+            : `${users.join(', ')} ${users.length === 1 ? 'is' : 'are'} typing...`;
+    }
+
+    // Сервер сам снимает индикатор через 5 секунд, повторяем не чаще раза в 3 секунды
+    notifyTyping() {
+        if (!this.events || this.events.readyState !== WebSocket.OPEN || !this.currentChat) return;
+        const now = Date.now();
+        if (now - this.lastTypingSent < 3000) return;
+        this.lastTypingSent = now;
+        this.events.send(JSON.stringify({ type: 'typing', chat_id: this.currentChat.chat_id }));
+    }
+
+    // Свои сообщения, прочитанные хотя бы одним другим участником
+    updateReadMarks() {
+        if (!this.currentChat) return;
+        const receipts = this.readReceipts[this.currentChat.chat_id] || {};
+        let maxRead = 0;
+        Object.keys(receipts).forEach(userId => {
+            if (Number(userId) !== Number(this.currentUserId)) {
+                maxRead = Math.max(maxRead, receipts[userId]);
+            }
+        });
+        document.querySelectorAll('.message-item.own').forEach(item => {
+            item.classList.toggle('read', Number(item.dataset.messageId) <= maxRead);
+        });
+    }
+
     // Polling for new messages
     startPolling() {
         this.pollingInterval = setInterval(() => {
@@ -754,6 +961,12 @@ document.addEventListener('DOMContentLoaded', function() {
     document.getElementById('message-input').addEventListener('keypress', function(e) {
         if (e.key === 'Enter') sendMessage();
     });
+    document.getElementById('message-input').addEventListener('input', function() {
+        if (chatApp) chatApp.notifyTyping();
+    });
+    window.addEventListener('focus', function() {
+        if (chatApp) chatApp.notifyActivity();
+    });
     
     // New chat name enter key
     document.getElementById('new-chat-name').addEventListener('keypress', function(e) {
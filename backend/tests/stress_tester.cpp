@@ -0,0 +1,391 @@
+#include "../src/chat_manager.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// Нагрузочный тест ChatManager: много потоков выполняют смешанную нагрузку
+// (register/login/send/read/join/create) против одного экземпляра, как это
+// делают рабочие потоки Crow. После каждого прогона проверяются инварианты.
+
+namespace {
+
+// Буфер, который выбрасывает всё: глушим отладочный вывод ChatManager во время прогона
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+struct SentMessage {
+    int chat_id;
+    int sender_id;
+    std::string content;
+};
+
+struct ThreadResult {
+    long long operations = 0;
+    long long failed_operations = 0;
+    std::vector<SentMessage> sent;
+    std::vector<std::pair<int, int>> memberships; // (user_id, chat_id)
+    std::vector<int> created_chats;
+    std::vector<int> users;
+};
+
+struct RunStats {
+    int threads = 0;
+    long long operations = 0;
+    long long failed_operations = 0;
+    double seconds = 0.0;
+    int violations = 0;
+};
+
+} // namespace
+
+class StressTester {
+private:
+    std::string db_path;
+    int ops_per_thread;
+    int shared_chats;
+    std::ostream& out;
+    ChatManager* chatManager;
+    std::vector<int> public_chats;
+
+public:
+    StressTester(std::ostream& output, int ops, int chats)
+        : db_path("stress_chat.db"), ops_per_thread(ops), shared_chats(chats),
+          out(output), chatManager(nullptr) {}
+
+    ~StressTester() {
+        delete chatManager;
+        std::remove(db_path.c_str());
+    }
+
+    RunStats run(int thread_count) {
+        setUp();
+
+        std::vector<ThreadResult> results(thread_count);
+        std::vector<std::thread> workers;
+        std::atomic<bool> start{false};
+
+        for (int t = 0; t < thread_count; t++) {
+            workers.emplace_back([this, t, &results, &start]() {
+                while (!start.load()) std::this_thread::yield();
+                worker(t, results[t]);
+            });
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        start = true;
+        for (auto& w : workers) w.join();
+        auto end = std::chrono::steady_clock::now();
+
+        RunStats stats;
+        stats.threads = thread_count;
+        stats.seconds = std::chrono::duration<double>(end - begin).count();
+        for (const auto& r : results) {
+            stats.operations += r.operations;
+            stats.failed_operations += r.failed_operations;
+        }
+        stats.violations = verify(results);
+        return stats;
+    }
+
+private:
+    void setUp() {
+        delete chatManager;
+        chatManager = nullptr;
+        std::remove(db_path.c_str());
+        chatManager = new ChatManager(db_path);
+        public_chats.clear();
+
+        int owner = chatManager->registerUser("stress_owner", "owner_pass");
+        if (owner <= 0) throw std::runtime_error("Failed to register chat owner");
+        for (int i = 0; i < shared_chats; i++) {
+            int chat_id = chatManager->createChat("Shared " + std::to_string(i), owner);
+            if (chat_id <= 0) throw std::runtime_error("Failed to create shared chat");
+            public_chats.push_back(chat_id);
+        }
+    }
+
+    void worker(int thread_id, ThreadResult& result) {
+        std::mt19937 gen(1234 + thread_id);
+        std::uniform_int_distribution<> op_dist(0, 99);
+
+        // У каждого потока свои пользователи, чаты общие
+        struct OwnUser {
+            int user_id;
+            std::string username;
+            std::string password;
+        };
+        std::vector<OwnUser> users;
+        std::vector<std::vector<int>> user_chats;
+        int user_seq = 0;
+        int message_seq = 0;
+
+        auto registerOne = [&]() {
+            std::string name = "stress_t" + std::to_string(thread_id) + "_u" + std::to_string(user_seq++);
+            std::string password = "pw_" + name;
+            int user_id = chatManager->registerUser(name, password);
+            if (user_id <= 0) return false;
+            users.push_back({user_id, name, password});
+            user_chats.emplace_back();
+            result.users.push_back(user_id);
+            return true;
+        };
+
+        if (!registerOne()) {
+            result.failed_operations++;
+            return;
+        }
+
+        for (int i = 0; i < ops_per_thread; i++) {
+            std::size_t u = std::uniform_int_distribution<std::size_t>(0, users.size() - 1)(gen);
+            int user_id = users[u].user_id;
+            int op = op_dist(gen);
+            bool ok = true;
+
+            if (op < 45) {
+                // send
+                if (user_chats[u].empty()) {
+                    op = 50; // сначала нужно куда-то вступить
+                } else {
+                    int chat_id = user_chats[u][gen() % user_chats[u].size()];
+                    std::string content = "t" + std::to_string(thread_id) + "-" + std::to_string(message_seq++);
+                    ok = chatManager->sendMessage(chat_id, user_id, content);
+                    if (ok) result.sent.push_back({chat_id, user_id, content});
+                }
+            }
+
+            if (op >= 45 && op < 70) {
+                // read
+                if (user_chats[u].empty()) {
+                    op = 70;
+                } else {
+                    int chat_id = user_chats[u][gen() % user_chats[u].size()];
+                    chatManager->getChatMessages(chat_id, user_id, 50);
+                    chatManager->getUserChats(user_id);
+                }
+            } else if (op >= 70 && op < 85) {
+                // join
+                int chat_id = public_chats[gen() % public_chats.size()];
+                bool already = false;
+                for (int id : user_chats[u]) {
+                    if (id == chat_id) already = true;
+                }
+                if (!already) {
+                    ok = chatManager->addUserToChat(user_id, chat_id);
+                    if (ok) {
+                        user_chats[u].push_back(chat_id);
+                        result.memberships.push_back({user_id, chat_id});
+                    }
+                }
+            } else if (op >= 85 && op < 92) {
+                // login
+                std::string token = chatManager->loginUser(users[u].username, users[u].password);
+                ok = !token.empty();
+                if (ok) {
+                    User* user = chatManager->getUserBySession(token);
+                    ok = (user != nullptr && user->user_id == user_id);
+                    delete user;
+                }
+            } else if (op >= 92 && op < 96) {
+                ok = registerOne();
+            } else if (op >= 96) {
+                // create
+                int chat_id = chatManager->createChat("t" + std::to_string(thread_id) + " room", user_id);
+                ok = (chat_id > 0);
+                if (ok) {
+                    user_chats[u].push_back(chat_id);
+                    result.created_chats.push_back(chat_id);
+                    result.memberships.push_back({user_id, chat_id});
+                }
+            }
+
+            result.operations++;
+            if (!ok) result.failed_operations++;
+        }
+    }
+
+    int verify(const std::vector<ThreadResult>& results) {
+        int violations = 0;
+        auto fail = [&](const std::string& what) {
+            if (violations < 20) out << "  VIOLATION: " << what << "\n";
+            violations++;
+        };
+
+        std::map<int, std::set<int>> expected_members;
+        std::map<int, std::vector<const SentMessage*>> expected_messages;
+        std::map<int, int> reader_for_chat;
+        std::set<int> all_chats(public_chats.begin(), public_chats.end());
+
+        for (int chat_id : public_chats) {
+            Chat* chat = chatManager->getChatById(chat_id);
+            if (chat) {
+                expected_members[chat_id].insert(chat->created_by);
+                reader_for_chat[chat_id] = chat->created_by;
+                delete chat;
+            }
+        }
+
+        std::set<int> created;
+        for (const auto& r : results) {
+            for (int chat_id : r.created_chats) {
+                if (!created.insert(chat_id).second) {
+                    fail("chat id " + std::to_string(chat_id) + " returned to two creators");
+                }
+                all_chats.insert(chat_id);
+            }
+            for (const auto& m : r.memberships) {
+                expected_members[m.second].insert(m.first);
+                reader_for_chat.emplace(m.second, m.first);
+            }
+            for (const auto& msg : r.sent) {
+                expected_messages[msg.chat_id].push_back(&msg);
+            }
+        }
+
+        // Состав участников совпадает с успешными join/create
+        for (int chat_id : all_chats) {
+            Chat* chat = chatManager->getChatById(chat_id);
+            if (!chat) {
+                fail("chat " + std::to_string(chat_id) + " is missing");
+                continue;
+            }
+            std::vector<int> member_ids = chatManager->getChatMembers(chat_id);
+            std::set<int> actual(member_ids.begin(), member_ids.end());
+            if (actual.size() != member_ids.size()) {
+                fail("chat " + std::to_string(chat_id) + " has duplicate members");
+            }
+            if (actual != expected_members[chat_id]) {
+                fail("chat " + std::to_string(chat_id) + " has " + std::to_string(actual.size()) +
+                     " members, expected " + std::to_string(expected_members[chat_id].size()));
+            }
+            delete chat;
+        }
+
+        // Список чатов пользователя согласован с таблицей участников
+        std::map<int, std::set<int>> expected_user_chats;
+        for (const auto& entry : expected_members) {
+            for (int user_id : entry.second) expected_user_chats[user_id].insert(entry.first);
+        }
+        for (const auto& r : results) {
+            for (int user_id : r.users) {
+                std::set<int> actual;
+                for (const auto& chat : chatManager->getUserChats(user_id)) actual.insert(chat.chat_id);
+                if (actual != expected_user_chats[user_id]) {
+                    fail("user " + std::to_string(user_id) + " sees " + std::to_string(actual.size()) +
+                         " chats, expected " + std::to_string(expected_user_chats[user_id].size()));
+                }
+            }
+        }
+
+        // Сообщения не потеряны, id растут в порядке отправки
+        for (const auto& entry : expected_messages) {
+            int chat_id = entry.first;
+            auto stored = chatManager->getChatMessages(chat_id, reader_for_chat[chat_id], 1 << 30);
+            if (stored.size() != entry.second.size()) {
+                fail("chat " + std::to_string(chat_id) + " stored " + std::to_string(stored.size()) +
+                     " messages, sent " + std::to_string(entry.second.size()));
+            }
+
+            std::map<std::string, long long> id_by_content;
+            long long previous_id = 0;
+            for (const auto& msg : stored) {
+                if (msg.message_id <= previous_id) {
+                    fail("chat " + std::to_string(chat_id) + " message ids are not monotonic");
+                }
+                previous_id = msg.message_id;
+                id_by_content[msg.content] = msg.message_id;
+            }
+
+            std::map<int, long long> last_id_by_sender;
+            for (const SentMessage* sent : entry.second) {
+                auto it = id_by_content.find(sent->content);
+                if (it == id_by_content.end()) {
+                    fail("message '" + sent->content + "' lost in chat " + std::to_string(chat_id));
+                    continue;
+                }
+                long long& last = last_id_by_sender[sent->sender_id];
+                if (it->second <= last) {
+                    fail("message '" + sent->content + "' reordered in chat " + std::to_string(chat_id));
+                }
+                last = it->second;
+            }
+        }
+
+        return violations;
+    }
+};
+
+int main(int argc, char* argv[]) {
+    int max_threads = argc > 1 ? std::atoi(argv[1]) : static_cast<int>(std::thread::hardware_concurrency());
+    int ops_per_thread = argc > 2 ? std::atoi(argv[2]) : 300;
+    int shared_chats = argc > 3 ? std::atoi(argv[3]) : 4;
+    if (max_threads <= 0) max_threads = 4;
+    if (ops_per_thread <= 0 || shared_chats <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [max_threads] [ops_per_thread] [shared_chats]\n";
+        return 1;
+    }
+
+    // Результаты пишем в отдельный поток вывода, std::cout глушим
+    std::ostream out(std::cout.rdbuf());
+    NullBuffer null_buffer;
+    std::streambuf* original = std::cout.rdbuf(&null_buffer);
+
+    out << "========================================\n";
+    out << "   CHAT MANAGER STRESS TEST\n";
+    out << "   threads: 1.." << max_threads << ", ops/thread: " << ops_per_thread
+        << ", shared chats: " << shared_chats << "\n";
+    out << "========================================\n";
+
+    int total_violations = 0;
+    try {
+        StressTester tester(out, ops_per_thread, shared_chats);
+        double baseline = 0.0;
+
+        std::vector<int> thread_counts;
+        for (int t = 1; t < max_threads; t *= 2) thread_counts.push_back(t);
+        thread_counts.push_back(max_threads);
+
+        for (int threads : thread_counts) {
+            RunStats stats = tester.run(threads);
+            double throughput = stats.operations / stats.seconds;
+            if (threads == 1) baseline = throughput;
+
+            out << std::fixed << std::setprecision(1)
+                << "threads=" << std::setw(3) << stats.threads
+                << "  ops=" << std::setw(7) << stats.operations
+                << "  failed=" << std::setw(5) << stats.failed_operations
+                << "  time=" << std::setw(6) << stats.seconds << "s"
+                << "  ops/s=" << std::setw(9) << throughput
+                << "  scaling=" << std::setprecision(2) << (baseline > 0 ? throughput / baseline : 0.0) << "x"
+                << "  violations=" << stats.violations << "\n";
+            total_violations += stats.violations;
+        }
+    } catch (const std::exception& e) {
+        std::cout.rdbuf(original);
+        std::cerr << "\nSTRESS TEST FAILED: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout.rdbuf(original);
+    out << "========================================\n";
+    if (total_violations == 0) {
+        out << "   ALL INVARIANTS HOLD\n";
+    } else {
+        out << "   " << total_violations << " INVARIANT VIOLATIONS\n";
+    }
+    out << "========================================\n";
+    return total_violations == 0 ? 0 : 1;
+}
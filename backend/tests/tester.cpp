@@ -3,9 +3,23 @@
 #include "../src/chat.h"
 #include "../src/message.h"
 #include "../src/chat_manager.h"
+#include "../src/password_hasher.h"
+#include "../src/session_signer.h"
+#include "../src/member_set.h"
+#include "../src/snowflake.h"
+#include "../src/name_index.h"
 #include <iostream>
 #include <cassert>
 #include <string>
+#include <set>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <iterator>
+#include <thread>
+#include <chrono>
+#include <climits>
+#include <cstdint>
 
 class ChatTester {
 private:
@@ -53,6 +67,8 @@ public:
         
         runTest("User Registration", [this]() { testUserRegistration(); });
         runTest("User Login", [this]() { testUserLogin(); });
+        runTest("Password Hashing", [this]() { testPasswordHashing(); });
+        runTest("Signed Sessions", [this]() { testSignedSessions(); });
         
         if (test_version == 2) {
             runTest("Chat Creation", [this]() { testChatCreation(); });
@@ -72,6 +88,12 @@ public:
             runTest("Invite Functionality", [this]() { testInviteFunctionality(); });
         }
         
+        runTest("Member Set", [this]() { testMemberSet(); });
+        runTest("Snowflake Message Ids", [this]() { testSnowflakeIds(); });
+        runTest("Direct Chats", [this]() { testDirectChats(); });
+        runTest("Message Search", [this]() { testMessageSearch(); });
+        runTest("Name Typeahead", [this]() { testNameTypeahead(); });
+        runTest("Public Chat Directory", [this]() { testPublicDirectory(); });
         runTest("Database Persistence", [this]() { testDatabasePersistence(); });
         
         std::cout << "\n========================================\n";
@@ -149,6 +171,79 @@ private:
         std::cout << "Wrong password correctly rejected\n";
     }
     
+    void testPasswordHashing() {
+        // Тест 2.3: Пароль хранится хешем PBKDF2, а не открытым текстом
+        User* alice = db->getUserByUsername("alice");
+        if (alice == nullptr) throw std::runtime_error("Could not load Alice");
+        bool hashed = PasswordHasher::isHashed(alice->password_hash) &&
+                      alice->password_hash.find("password123") == std::string::npos;
+        delete alice;
+        if (!hashed) throw std::runtime_error("Password should be stored as a PBKDF2 hash");
+        std::cout << "Password stored as PBKDF2 hash\n";
+        
+        // Тест 2.4: Запись до хеширования (открытый текст) принимается и перехешируется при входе
+        if (db->createUser("legacy", "oldpassword", "legacy@example.com") <= 0)
+            throw std::runtime_error("Legacy user insert failed");
+        if (chatManager->loginUser("legacy", "oldpassword").empty())
+            throw std::runtime_error("Legacy plaintext password should be accepted");
+        User* legacy = db->getUserByUsername("legacy");
+        if (legacy == nullptr) throw std::runtime_error("Could not load legacy user");
+        bool rehashed = PasswordHasher::isHashed(legacy->password_hash);
+        delete legacy;
+        if (!rehashed) throw std::runtime_error("Legacy password should be rehashed on login");
+        if (chatManager->loginUser("legacy", "oldpassword").empty())
+            throw std::runtime_error("Login should succeed after rehash");
+        if (!chatManager->loginUser("legacy", "wrongpassword").empty())
+            throw std::runtime_error("Wrong password should fail after rehash");
+        std::cout << "Legacy plaintext password rehashed on login\n";
+        
+        // Тест 2.5: Хеш со старым числом итераций верен, но требует перехеширования
+        bool needs_rehash = false;
+        if (!PasswordHasher::verify("secret", PasswordHasher::hash("secret", 1000), needs_rehash) || !needs_rehash)
+            throw std::runtime_error("Hash with fewer iterations should verify and need rehash");
+        if (PasswordHasher::verify("other", PasswordHasher::hash("secret", 1000), needs_rehash))
+            throw std::runtime_error("Wrong password should not verify");
+        std::cout << "Iteration upgrade detected\n";
+    }
+    
+    void testSignedSessions() {
+        std::string token = chatManager->loginUser("bob", "password456");
+        std::string phone_token = chatManager->loginUser("bob", "password456", "phone");
+        if (!SessionSigner::isSigned(token) || !SessionSigner::isSigned(phone_token))
+            throw std::runtime_error("Login should issue signed tokens");
+        std::shared_ptr<const User> bob = chatManager->authenticate(token);
+        if (bob == nullptr) throw std::runtime_error("Signed token should authenticate");
+        int bob_id = bob->user_id;
+        
+        // Тест 2.6: Испорченная подпись и чужой секрет отклоняются
+        std::string forged = token;
+        forged[forged.size() - 1] = forged[forged.size() - 1] == '0' ? '1' : '0';
+        if (chatManager->authenticate(forged) != nullptr)
+            throw std::runtime_error("Token with a broken signature should be rejected");
+        SessionSigner stranger(SessionSigner::generateSecret());
+        if (chatManager->authenticate(stranger.issue(bob_id, SessionSigner::now() + 3600)) != nullptr)
+            throw std::runtime_error("Token signed with another secret should be rejected");
+        
+        // Тест 2.7: Токен с секретом сервера проверяется без строки в sessions, кроме истёкших
+        std::string secret;
+        if (!db->getSetting("session_secret", secret)) throw std::runtime_error("Session secret should be stored");
+        SessionSigner server_signer(secret);
+        std::shared_ptr<const User> issued = chatManager->authenticate(server_signer.issue(bob_id, SessionSigner::now() + 3600));
+        if (issued == nullptr || issued->user_id != bob_id)
+            throw std::runtime_error("Token signed with the server secret should authenticate");
+        if (chatManager->authenticate(server_signer.issue(bob_id, SessionSigner::now() - 1)) != nullptr)
+            throw std::runtime_error("Expired token should be rejected");
+        std::cout << "Signature and expiry are verified\n";
+        
+        // Тест 2.8: Выход отзывает только свой токен, сессия другого устройства жива
+        if (!chatManager->logoutUser(token)) throw std::runtime_error("Logout should succeed");
+        if (chatManager->authenticate(token) != nullptr)
+            throw std::runtime_error("Revoked token should be rejected");
+        if (chatManager->authenticate(phone_token) == nullptr)
+            throw std::runtime_error("Other device session should stay valid");
+        std::cout << "Logout revokes only its own token\n";
+    }
+    
     void testChatCreation() {
         std::string alice_token = chatManager->loginUser("alice", "password123");
         if (alice_token.empty()) throw std::runtime_error("Alice login failed");
@@ -430,11 +525,50 @@ private:
         if (!charlie_sees_alice_public) throw std::runtime_error("Charlie should now see Alice's public chat");
         std::cout << "Charlie now sees Alice's public chat in his list\n";
         
+        // Тест 7.3.1: Количество участников считается без загрузки списка
+        for (const auto& chat : charlie_chats) {
+            if (chat.chat_id == 1 && chat.member_count != 2)
+                throw std::runtime_error("Alice's public chat should have 2 members");
+        }
+        if (chatManager->getChatMembers(1).size() != 2)
+            throw std::runtime_error("Member list should be loaded on demand");
+        std::cout << "Member count and lazy member list are correct\n";
+        
         // Тест 7.4: Charlie отправляет сообщение в публичный чат Alice
         bool charlie_message = chatManager->sendMessage(1, charlie->user_id, "Hi from Charlie in public chat!");
         if (!charlie_message) throw std::runtime_error("Charlie should send message after joining public chat");
         std::cout << "Charlie can send message in public chat after joining\n";
         
+        // Тест 7.5: Сообщение Charlie непрочитано у Alice, но не у самого Charlie
+        std::string alice_token = chatManager->loginUser("alice", "password123");
+        User* alice = chatManager->getUserBySession(alice_token);
+        if (alice == nullptr) throw std::runtime_error("Could not get Alice");
+        if (chatManager->getUnreadCount(alice->user_id, 1) != 1)
+            throw std::runtime_error("Alice should have 1 unread message");
+        if (chatManager->getUnreadCount(charlie->user_id, 1) != 0)
+            throw std::runtime_error("Own message should not be unread");
+        
+        ReadStateTracker::State read_state;
+        if (!chatManager->markChatRead(alice->user_id, 1, 0, read_state) || read_state.unread_count != 0)
+            throw std::runtime_error("Marking chat as read should reset unread count");
+        if (chatManager->markChatRead(david->user_id, 1, 0, read_state))
+            throw std::runtime_error("Non-member should not mark chat as read");
+        std::cout << "Unread counters are updated on send and read\n";
+        
+        // Тест 7.6: Загруженная отметка прочтения не даёт доступа после выхода из чата
+        if (!chatManager->removeUserFromChat(charlie->user_id, 1))
+            throw std::runtime_error("Charlie should leave Alice's public chat");
+        if (chatManager->isUserInChat(charlie->user_id, 1))
+            throw std::runtime_error("Charlie should not be a member after leaving");
+        if (chatManager->markChatRead(charlie->user_id, 1, 0, read_state))
+            throw std::runtime_error("Former member should not mark chat as read");
+        if (chatManager->sendMessage(1, charlie->user_id, "Should not work after leaving"))
+            throw std::runtime_error("Former member should not send messages");
+        if (!chatManager->addUserToChat(charlie->user_id, 1))
+            throw std::runtime_error("Charlie should rejoin Alice's public chat");
+        std::cout << "Read state does not outlive membership\n";
+        
+        delete alice;
         delete charlie;
         delete david;
     }
@@ -526,9 +660,362 @@ private:
         delete david;
     }
     
+    static void checkSameMembers(const MemberSet& actual, const std::set<int>& expected, const std::string& what) {
+        std::vector<int> ids = actual.toVector();
+        if (actual.size() != expected.size() || !std::equal(ids.begin(), ids.end(), expected.begin(), expected.end()))
+            throw std::runtime_error("MemberSet differs from std::set: " + what);
+    }
+    
+    void testMemberSet() {
+        std::mt19937 rng(12345);
+        
+        // Тест 10.1: Вставка и удаление вокруг границы массив/битовая карта (4096 в контейнере)
+        MemberSet members;
+        std::set<int> expected;
+        std::uniform_int_distribution<int> low(0, 65535);
+        while (expected.size() < MemberSet::ARRAY_LIMIT + 500) {
+            int id = low(rng);
+            if (members.insert(id) != expected.insert(id).second)
+                throw std::runtime_error("insert result differs for " + std::to_string(id));
+        }
+        checkSameMembers(members, expected, "after growing past ARRAY_LIMIT");
+        
+        std::vector<int> present(expected.begin(), expected.end());
+        std::shuffle(present.begin(), present.end(), rng);
+        for (int id : present) {
+            if (!members.erase(id) || expected.erase(id) != 1)
+                throw std::runtime_error("erase should remove " + std::to_string(id));
+            if (members.erase(id)) throw std::runtime_error("second erase should fail");
+            if (expected.size() % 256 == 0) checkSameMembers(members, expected, "while shrinking");
+        }
+        if (!members.empty()) throw std::runtime_error("MemberSet should be empty after erasing everything");
+        
+        // Чередование insert/erase на самой границе и поиск по соседним id
+        for (int id = 0; id < static_cast<int>(MemberSet::ARRAY_LIMIT); id++) {
+            members.insert(id * 3);
+            expected.insert(id * 3);
+        }
+        for (int round = 0; round < 100; round++) {
+            int id = 3 * static_cast<int>(MemberSet::ARRAY_LIMIT) + round % 2;
+            members.insert(id);
+            expected.insert(id);
+            members.erase(id);
+            expected.erase(id);
+        }
+        checkSameMembers(members, expected, "after alternating at the boundary");
+        for (int id = 0; id < 3 * static_cast<int>(MemberSet::ARRAY_LIMIT); id++) {
+            if (members.contains(id) != (expected.count(id) == 1))
+                throw std::runtime_error("contains differs for " + std::to_string(id));
+        }
+        std::cout << "Insert/erase/contains match std::set across the 4096 boundary\n";
+        
+        // Тест 10.2: Пересечение для всех сочетаний массив/битовая карта и разных ключей
+        const int sizes[] = {50, 2000, 6000, 20000};
+        for (int size_a : sizes) {
+            for (int size_b : sizes) {
+                std::set<int> set_a, set_b;
+                std::uniform_int_distribution<int> any(0, 3 * 65536 - 1);
+                while (static_cast<int>(set_a.size()) < size_a) set_a.insert(any(rng));
+                while (static_cast<int>(set_b.size()) < size_b) set_b.insert(any(rng));
+                MemberSet a(std::vector<int>(set_a.begin(), set_a.end()));
+                MemberSet b(std::vector<int>(set_b.begin(), set_b.end()));
+                
+                std::set<int> both;
+                std::set_intersection(set_a.begin(), set_a.end(), set_b.begin(), set_b.end(),
+                                      std::inserter(both, both.begin()));
+                std::string what = "intersect " + std::to_string(size_a) + " x " + std::to_string(size_b);
+                checkSameMembers(a.intersect(b), both, what);
+                if (a.intersectionSize(b) != both.size() || b.intersectionSize(a) != both.size())
+                    throw std::runtime_error("intersectionSize differs: " + what);
+            }
+        }
+        std::cout << "Intersections match std::set_intersection\n";
+    }
+    
+    void testSnowflakeIds() {
+        const std::int64_t MAX_SAFE_ID = (std::int64_t(1) << 53) - 1; // Number.MAX_SAFE_INTEGER
+        SnowflakeGenerator generator(3);
+        
+        // Тест 11.1: id строго растут, умещаются в 53 бита и несут узел и время
+        std::int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        std::int64_t previous = 0;
+        for (int i = 0; i < 50000; i++) {
+            std::int64_t id = generator.next();
+            if (id <= previous) throw std::runtime_error("Snowflake ids should strictly increase");
+            if (id > MAX_SAFE_ID) throw std::runtime_error("Snowflake id should fit in 53 bits");
+            previous = id;
+        }
+        if (SnowflakeGenerator::nodeOf(previous) != 3) throw std::runtime_error("Node should be encoded in the id");
+        std::int64_t created = SnowflakeGenerator::timestampOf(previous);
+        // 50000 id при 128 на мс могут уйти вперёд часов примерно на 400 мс
+        if (created < now_ms - 1000 || created > now_ms + 5000)
+            throw std::runtime_error("Timestamp should be decodable from the id");
+        std::cout << "Ids increase, fit in 53 bits and carry node and time\n";
+        
+        // Тест 11.2: Уникальность при генерации из нескольких потоков
+        const int THREADS = 4, PER_THREAD = 20000;
+        std::vector<std::vector<std::int64_t>> ids(THREADS);
+        std::vector<std::thread> workers;
+        for (int t = 0; t < THREADS; t++) {
+            workers.emplace_back([&generator, &ids, t]() {
+                for (int i = 0; i < PER_THREAD; i++) ids[t].push_back(generator.next());
+            });
+        }
+        for (auto& worker : workers) worker.join();
+        std::set<std::int64_t> unique;
+        for (const auto& thread_ids : ids) {
+            if (!std::is_sorted(thread_ids.begin(), thread_ids.end()))
+                throw std::runtime_error("Ids should increase within each thread");
+            unique.insert(thread_ids.begin(), thread_ids.end());
+        }
+        if (unique.size() != static_cast<std::size_t>(THREADS * PER_THREAD) || *unique.begin() <= previous)
+            throw std::runtime_error("Concurrent ids should be unique and above earlier ones");
+        std::cout << "Concurrent ids are unique\n";
+        
+        // Тест 11.3: Сообщения чата получают растущие id в порядке отправки
+        std::string alice_token = chatManager->loginUser("alice", "password123");
+        User* alice = chatManager->getUserBySession(alice_token);
+        if (alice == nullptr) throw std::runtime_error("Could not get Alice");
+        for (int i = 0; i < 3; i++) {
+            if (!chatManager->sendMessage(1, alice->user_id, "Ordered " + std::to_string(i)))
+                throw std::runtime_error("Alice should send to her chat");
+        }
+        auto messages = chatManager->getChatMessages(1, alice->user_id, 3);
+        delete alice;
+        if (messages.size() != 3) throw std::runtime_error("Should read back 3 messages");
+        for (std::size_t i = 0; i < messages.size(); i++) {
+            if (messages[i].content != "Ordered " + std::to_string(i))
+                throw std::runtime_error("Messages should come back in send order");
+            if (i > 0 && messages[i].message_id <= messages[i - 1].message_id)
+                throw std::runtime_error("Message ids should follow send order");
+        }
+        std::cout << "Message ids follow send order\n";
+        
+        // Тест 11.4: После перезапуска с часами, ушедшими назад, id продолжают сохранённые
+        const int SEQ = SnowflakeGenerator::SEQUENCE_BITS;
+        std::int64_t hour_ahead = (now_ms + 3600 * 1000 - SnowflakeGenerator::EPOCH_MS) << (SnowflakeGenerator::NODE_BITS + SEQ);
+        // свой узел, чужой узел, последний счётчик миллисекунды
+        std::int64_t stored_ids[] = {hour_ahead | (3 << SEQ) | 5, hour_ahead | (7 << SEQ) | 5, hour_ahead | (3 << SEQ) | ((1 << SEQ) - 1)};
+        for (std::int64_t stored : stored_ids) {
+            SnowflakeGenerator restarted(3);
+            restarted.seed(stored);
+            std::int64_t first = restarted.next();
+            if (first <= stored) throw std::runtime_error("Ids should continue above the seeded id");
+            if (SnowflakeGenerator::nodeOf(first) != 3) throw std::runtime_error("Seeded ids should keep the node");
+            if (restarted.next() <= first) throw std::runtime_error("Seeded ids should keep increasing");
+        }
+        std::cout << "Seeded generator continues above stored ids\n";
+    }
+    
+    int userId(const std::string& username) {
+        User* user = db->getUserByUsername(username);
+        if (user == nullptr) throw std::runtime_error("Could not load " + username);
+        int user_id = user->user_id;
+        delete user;
+        return user_id;
+    }
+    
+    void testDirectChats() {
+        int bob_id = userId("bob");
+        int charlie_id = userId("charlie");
+        
+        // Тест 12.1: Параллельное открытие в обоих порядках пары создаёт ровно один чат
+        const int THREADS = 8;
+        std::vector<int> chat_ids(THREADS, 0);
+        std::vector<char> created(THREADS, 0);
+        std::vector<std::thread> workers;
+        for (int t = 0; t < THREADS; t++) {
+            workers.emplace_back([this, t, bob_id, charlie_id, &chat_ids, &created]() {
+                bool was_created = false;
+                chat_ids[t] = t % 2 ? chatManager->openDirectChat(bob_id, charlie_id, was_created)
+                                    : chatManager->openDirectChat(charlie_id, bob_id, was_created);
+                created[t] = was_created;
+            });
+        }
+        for (auto& worker : workers) worker.join();
+        
+        int direct_id = chat_ids[0];
+        if (direct_id <= 0) throw std::runtime_error("Direct chat should be opened");
+        for (int t = 0; t < THREADS; t++) {
+            if (chat_ids[t] != direct_id) throw std::runtime_error("Both orders of the pair should get one chat");
+        }
+        if (std::count(created.begin(), created.end(), 1) != 1)
+            throw std::runtime_error("Exactly one concurrent call should create the chat");
+        std::cout << "Concurrent opens share one direct chat (ID: " << direct_id << ")\n";
+        
+        // Тест 12.2: Повторное открытие находит тот же чат, участники - ровно пара
+        bool was_created = true;
+        if (chatManager->openDirectChat(charlie_id, bob_id, was_created) != direct_id || was_created)
+            throw std::runtime_error("Reopening should return the existing chat");
+        std::vector<int> members = chatManager->getChatMembers(direct_id);
+        std::sort(members.begin(), members.end());
+        std::vector<int> pair = {std::min(bob_id, charlie_id), std::max(bob_id, charlie_id)};
+        if (members != pair) throw std::runtime_error("Direct chat members should be exactly the pair");
+        
+        // Тест 12.3: Третий не может войти, с самим собой чата нет
+        int outsider_id = userId("legacy");
+        if (chatManager->addUserToChat(outsider_id, direct_id))
+            throw std::runtime_error("Nobody else should join a direct chat");
+        if (chatManager->openDirectChat(bob_id, bob_id, was_created) != -1)
+            throw std::runtime_error("Direct chat with oneself should be rejected");
+        std::cout << "Direct chat is closed to others\n";
+    }
+    
+    static std::set<int> chatsOf(const std::vector<Message>& results) {
+        std::set<int> chat_ids;
+        for (const auto& message : results) chat_ids.insert(message.chat_id);
+        return chat_ids;
+    }
+    
+    void testMessageSearch() {
+        int bob_id = userId("bob");
+        int charlie_id = userId("charlie");
+        
+        int bob_private = chatManager->createChat("Bob's Notes", bob_id, "group", false);
+        int charlie_public = chatManager->createChat("Charlie's Aquarium", charlie_id, "group", true);
+        if (bob_private <= 0 || charlie_public <= 0) throw std::runtime_error("Search chats should be created");
+        if (!chatManager->sendMessage(bob_private, bob_id, "Zebrafish migration notes") ||
+            !chatManager->sendMessage(charlie_public, charlie_id, "A zebrafish in the public tank") ||
+            !chatManager->sendMessage(charlie_public, charlie_id, "Зебра на обоях"))
+            throw std::runtime_error("Search messages should be sent");
+        
+        // Тест 13.1: Находятся только сообщения из чатов пользователя
+        auto charlie_results = chatManager->searchMessages(charlie_id, "zebrafish", 0, 20, 0);
+        if (chatsOf(charlie_results) != std::set<int>{charlie_public})
+            throw std::runtime_error("Charlie should find only messages from his chats");
+        auto bob_results = chatManager->searchMessages(bob_id, "zebrafish", 0, 20, 0);
+        if (chatsOf(bob_results) != std::set<int>{bob_private})
+            throw std::runtime_error("Bob should not find messages from chats he is not in");
+        if (bob_results[0].sender_name != "bob" || bob_results[0].content.find('[') == std::string::npos)
+            throw std::runtime_error("Result should carry sender name and a highlighted snippet");
+        std::cout << "Search is scoped to the user's chats\n";
+        
+        // Тест 13.2: После вступления в чат его сообщения ищутся; chat_id сужает поиск
+        if (!chatManager->addUserToChat(bob_id, charlie_public)) throw std::runtime_error("Bob should join Charlie's chat");
+        if (chatsOf(chatManager->searchMessages(bob_id, "zebrafish", 0, 20, 0)) != std::set<int>{bob_private, charlie_public})
+            throw std::runtime_error("Joined chat should become searchable");
+        if (chatsOf(chatManager->searchMessages(bob_id, "zebrafish", charlie_public, 20, 0)) != std::set<int>{charlie_public})
+            throw std::runtime_error("chat_id should narrow the search");
+        
+        // Тест 13.3: Префикс последнего слова и регистр кириллицы
+        if (chatManager->searchMessages(charlie_id, "zebr", 0, 20, 0).size() != 1)
+            throw std::runtime_error("Last word should match as a prefix");
+        if (chatManager->searchMessages(charlie_id, "ЗЕБРА", 0, 20, 0).size() != 1)
+            throw std::runtime_error("Cyrillic search should ignore case");
+        if (!chatManager->searchMessages(charlie_id, "notes", 0, 20, 0).empty())
+            throw std::runtime_error("Words from other chats should not match");
+        std::cout << "Prefix, case folding and chat filter work\n";
+    }
+    
+    void testNameTypeahead() {
+        // Тест 14.1: Постраничный обход префикса через слияние recent с основным массивом
+        NameIndex index;
+        std::set<int> expected;
+        const int NAMES = 6000; // больше порога слияния: часть имён в sorted, часть в recent
+        for (int id = NAMES; id >= 1; id--) {
+            std::string name = (id % 3 ? "User" : "Guest") + std::to_string(id);
+            index.add(id, name);
+            if (id % 3 && name.compare(0, 5, "User1") == 0) expected.insert(id);
+        }
+        index.add(7, "Duplicate"); // id уже есть - игнорируется
+        if (index.size() != static_cast<std::size_t>(NAMES)) throw std::runtime_error("Duplicate id should be ignored");
+        
+        std::set<int> seen;
+        std::string previous_key;
+        int after = 0;
+        while (true) {
+            auto page = index.find("uSeR1", after, 37);
+            for (const auto& match : page) {
+                if (!seen.insert(match.id).second) throw std::runtime_error("Paging should not repeat names");
+                std::string key = NameIndex::fold(match.name);
+                if (key < previous_key) throw std::runtime_error("Matches should come in name order");
+                previous_key = key;
+            }
+            if (page.size() < 37) break;
+            after = page.back().id;
+        }
+        if (seen != expected) throw std::runtime_error("Paging should return every name with the prefix");
+        std::cout << "Prefix paging returns " << seen.size() << " names without gaps or repeats\n";
+        
+        // Тест 14.2: Регистр кириллицы (включая Ё)
+        index.add(NAMES + 1, "Ёлка");
+        index.add(NAMES + 2, "ёжик");
+        index.add(NAMES + 3, "Яблоко");
+        if (index.find("Ё", 0, 10).size() != 2 || index.find("ё", 0, 10).size() != 2)
+            throw std::runtime_error("Ё and ё should fold together");
+        auto apple = index.find("яБЛ", 0, 10);
+        if (apple.size() != 1 || apple[0].name != "Яблоко")
+            throw std::runtime_error("Cyrillic prefix should ignore case and keep the original name");
+        std::cout << "Cyrillic case folding works\n";
+        
+        // Тест 14.3: ChatManager подхватывает новых пользователей без перезапуска
+        int zoe_id = chatManager->registerUser("Zoe", "password000", "zoe@example.com");
+        auto users = chatManager->searchUsers("zo", 0, 10);
+        if (zoe_id <= 0 || users.size() != 1 || users[0].id != zoe_id)
+            throw std::runtime_error("Registered user should be found by prefix");
+        std::cout << "New users are searchable immediately\n";
+    }
+    
+    // Обход каталога страницами по курсору (значение, chat_id), как делает /api/chats/directory
+    std::vector<Chat> walkDirectory(DirectorySort sort, int page_size) {
+        std::vector<Chat> all;
+        std::int64_t after_value = INT64_MAX;
+        int after_id = INT_MAX;
+        while (true) {
+            std::vector<Chat> page = chatManager->getPublicChats(sort, after_value, after_id, page_size);
+            all.insert(all.end(), page.begin(), page.end());
+            if (static_cast<int>(page.size()) < page_size) break;
+            after_value = sort == DIRECTORY_BY_MEMBERS ? page.back().member_count : page.back().last_message_at;
+            after_id = page.back().chat_id;
+        }
+        return all;
+    }
+    
+    void testPublicDirectory() {
+        int bob_id = userId("bob");
+        int charlie_id = userId("charlie");
+        int zoe_id = userId("Zoe");
+        
+        // Чаты с повторяющимися member_count: курсор должен различать их по chat_id
+        for (int i = 0; i < 12; i++) {
+            int chat_id = chatManager->createChat("Directory " + std::to_string(i), bob_id, "group", true);
+            if (chat_id <= 0) throw std::runtime_error("Directory chat should be created");
+            if (i % 3 >= 1) chatManager->addUserToChat(charlie_id, chat_id);
+            if (i % 3 == 2) chatManager->addUserToChat(zoe_id, chat_id);
+            if (i % 4 == 0) chatManager->sendMessage(chat_id, bob_id, "Activity " + std::to_string(i));
+        }
+        int hidden = chatManager->createChat("Directory hidden", bob_id, "group", false);
+        
+        std::set<int> expected;
+        for (const Chat& chat : chatManager->getAllChats()) {
+            if (chat.is_public) expected.insert(chat.chat_id);
+        }
+        
+        const DirectorySort sorts[] = {DIRECTORY_BY_MEMBERS, DIRECTORY_BY_ACTIVITY};
+        for (DirectorySort sort : sorts) {
+            std::vector<Chat> walked = walkDirectory(sort, 4);
+            std::set<int> seen;
+            for (std::size_t i = 0; i < walked.size(); i++) {
+                if (!walked[i].is_public || walked[i].chat_id == hidden)
+                    throw std::runtime_error("Directory should list only public chats");
+                if (!seen.insert(walked[i].chat_id).second)
+                    throw std::runtime_error("Directory paging should not repeat chats");
+                if (i == 0) continue;
+                std::int64_t previous = sort == DIRECTORY_BY_MEMBERS ? walked[i - 1].member_count : walked[i - 1].last_message_at;
+                std::int64_t current = sort == DIRECTORY_BY_MEMBERS ? walked[i].member_count : walked[i].last_message_at;
+                if (current > previous || (current == previous && walked[i].chat_id > walked[i - 1].chat_id))
+                    throw std::runtime_error("Directory should be ordered by value, then chat_id, descending");
+            }
+            if (seen != expected) throw std::runtime_error("Directory paging should not skip public chats");
+        }
+        std::cout << "Directory pages cover " << expected.size() << " public chats in order, without gaps or repeats\n";
+    }
+    
     void testDatabasePersistence() {
         delete chatManager;
         delete db;
+        db = nullptr;
         
         chatManager = new ChatManager(test_db_path);
         
@@ -569,6 +1056,13 @@ private:
             
             delete charlie;
             delete private_chat;
+            
+            // Отметки прочтения сбрасываются в БД при закрытии
+            if (chatManager->getUnreadCount(alice->user_id, 1) != 0)
+                throw std::runtime_error("Read marker should persist");
+            if (chatManager->getUnreadCount(alice->user_id, 2) != 1)
+                throw std::runtime_error("Charlie's private message should stay unread for Alice");
+            std::cout << "Read markers persisted\n";
         }
         
         // Проверяем сообщения
@@ -116,6 +116,20 @@ g++ -std=c++17 -O2 -pthread ^
   "../backend/src/chat.cpp" ^
   "../backend/src/message.cpp" ^
   "../backend/src/database.cpp" ^
+  "../backend/src/task_executor.cpp" ^
+  "../backend/src/message_cache.cpp" ^
+  "../backend/src/read_state.cpp" ^
+  "../backend/src/event_hub.cpp" ^
+  "../backend/src/timer_wheel.cpp" ^
+  "../backend/src/typing.cpp" ^
+  "../backend/src/presence.cpp" ^
+  "../backend/src/session_signer.cpp" ^
+  "../backend/src/password_hasher.cpp" ^
+  "../backend/src/token_generator.cpp" ^
+  "../backend/src/snowflake.cpp" ^
+  "../backend/src/user_names.cpp" ^
+  "../backend/src/member_set.cpp" ^
+  "../backend/src/name_index.cpp" ^
   -lws2_32 -lwsock32 -lbcrypt -lsqlite3 ^
   -o web_chat_server.exe
 
@@ -135,6 +149,20 @@ if %errorlevel% neq 0 (
           "../backend/src/chat.cpp" ^
           "../backend/src/message.cpp" ^
           "../backend/src/database.cpp" ^
+          "../backend/src/task_executor.cpp" ^
+          "../backend/src/message_cache.cpp" ^
+          "../backend/src/read_state.cpp" ^
+          "../backend/src/event_hub.cpp" ^
+          "../backend/src/timer_wheel.cpp" ^
+          "../backend/src/typing.cpp" ^
+          "../backend/src/presence.cpp" ^
+          "../backend/src/session_signer.cpp" ^
+          "../backend/src/password_hasher.cpp" ^
+          "../backend/src/token_generator.cpp" ^
+          "../backend/src/snowflake.cpp" ^
+          "../backend/src/user_names.cpp" ^
+          "../backend/src/member_set.cpp" ^
+          "../backend/src/name_index.cpp" ^
           -lws2_32 -lwsock32 -lbcrypt "%SQLITE_LIB%" ^
           -o web_chat_server.exe
     ) else if exist "libsqlite3.a" (
@@ -150,6 +178,20 @@ if %errorlevel% neq 0 (
           "../backend/src/chat.cpp" ^
           "../backend/src/message.cpp" ^
           "../backend/src/database.cpp" ^
+          "../backend/src/task_executor.cpp" ^
+          "../backend/src/message_cache.cpp" ^
+          "../backend/src/read_state.cpp" ^
+          "../backend/src/event_hub.cpp" ^
+          "../backend/src/timer_wheel.cpp" ^
+          "../backend/src/typing.cpp" ^
+          "../backend/src/presence.cpp" ^
+          "../backend/src/session_signer.cpp" ^
+          "../backend/src/password_hasher.cpp" ^
+          "../backend/src/token_generator.cpp" ^
+          "../backend/src/snowflake.cpp" ^
+          "../backend/src/user_names.cpp" ^
+          "../backend/src/member_set.cpp" ^
+          "../backend/src/name_index.cpp" ^
           -lws2_32 -lwsock32 -lbcrypt "libsqlite3.a" ^
           -o web_chat_server.exe
     ) else (
@@ -165,6 +207,20 @@ if %errorlevel% neq 0 (
           "../backend/src/chat.cpp" ^
           "../backend/src/message.cpp" ^
           "../backend/src/database.cpp" ^
+          "../backend/src/task_executor.cpp" ^
+          "../backend/src/message_cache.cpp" ^
+          "../backend/src/read_state.cpp" ^
+          "../backend/src/event_hub.cpp" ^
+          "../backend/src/timer_wheel.cpp" ^
+          "../backend/src/typing.cpp" ^
+          "../backend/src/presence.cpp" ^
+          "../backend/src/session_signer.cpp" ^
+          "../backend/src/password_hasher.cpp" ^
+          "../backend/src/token_generator.cpp" ^
+          "../backend/src/snowflake.cpp" ^
+          "../backend/src/user_names.cpp" ^
+          "../backend/src/member_set.cpp" ^
+          "../backend/src/name_index.cpp" ^
           -lws2_32 -lwsock32 -lbcrypt ^
           -o web_chat_server.exe
     )
@@ -36,6 +36,19 @@ g++ -std=c++17 -O2 ^
   "..\..\backend\src\chat.cpp" ^
   "..\..\backend\src\message.cpp" ^
   "..\..\backend\src\database.cpp" ^
+  "..\..\backend\src\message_cache.cpp" ^
+  "..\..\backend\src\read_state.cpp" ^
+  "..\..\backend\src\event_hub.cpp" ^
+  "..\..\backend\src\timer_wheel.cpp" ^
+  "..\..\backend\src\typing.cpp" ^
+  "..\..\backend\src\presence.cpp" ^
+  "..\..\backend\src\session_signer.cpp" ^
+  "..\..\backend\src\password_hasher.cpp" ^
+  "..\..\backend\src\token_generator.cpp" ^
+  "..\..\backend\src\snowflake.cpp" ^
+  "..\..\backend\src\user_names.cpp" ^
+  "..\..\backend\src\member_set.cpp" ^
+  "..\..\backend\src\name_index.cpp" ^
   -lws2_32 -lwsock32 -lbcrypt -lsqlite3 ^
   -o tester.exe
 
@@ -54,6 +67,19 @@ if %errorlevel% neq 0 (
           "..\..\backend\src\chat.cpp" ^
           "..\..\backend\src\message.cpp" ^
           "..\..\backend\src\database.cpp" ^
+          "..\..\backend\src\message_cache.cpp" ^
+          "..\..\backend\src\read_state.cpp" ^
+          "..\..\backend\src\event_hub.cpp" ^
+          "..\..\backend\src\timer_wheel.cpp" ^
+          "..\..\backend\src\typing.cpp" ^
+          "..\..\backend\src\presence.cpp" ^
+          "..\..\backend\src\session_signer.cpp" ^
+          "..\..\backend\src\password_hasher.cpp" ^
+          "..\..\backend\src\token_generator.cpp" ^
+          "..\..\backend\src\snowflake.cpp" ^
+          "..\..\backend\src\user_names.cpp" ^
+          "..\..\backend\src\member_set.cpp" ^
+          "..\..\backend\src\name_index.cpp" ^
           -lws2_32 -lwsock32 -lbcrypt "..\libsqlite3.a" ^
           -o tester.exe
     ) else (